@@ -1,388 +1,3283 @@
 #include <iostream>
 #include <vector>
+#include <string>
 #include <memory>
 #include <random>
+#include <fstream>
+#include <cstdint>
 #include <thread>
 #include <chrono>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <array>
+#include <utility>
 #include <termios.h>
 #include <unistd.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/ioctl.h>
 #include <fcntl.h>
+#include <csignal>
+#include <cerrno>
 #include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <limits>
+#include <iterator>
+#include <type_traits>
+#include <cstring>
+#include <cmath>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+class TerminalSession {
+private:
+    static TerminalSession* active_session;
+    static volatile std::sig_atomic_t resize_pending;
+    struct termios original;
+    bool is_raw;
+    int output_fd;
+
+    static void handleResize(int) {
+        resize_pending = 1;
+    }
 
-bool kbhit() {
-    struct termios oldt, newt;
-    int ch;
-    int oldf;
+    static void handleSignal(int sig) {
+        if (active_session != nullptr) {
+            active_session->restore();
+        }
+        signal(sig, SIG_DFL);
+        raise(sig);
+    }
 
-    tcgetattr(STDIN_FILENO, &oldt);
-    newt = oldt;
-    newt.c_lflag &= ~(ICANON | ECHO);
-    tcsetattr(STDIN_FILENO, TCSANOW, &newt);
-    oldf = fcntl(STDIN_FILENO, F_GETFL, 0);
-    fcntl(STDIN_FILENO, F_SETFL, oldf | O_NONBLOCK);
+public:
+    TerminalSession() : original(), is_raw(false), output_fd(-1) {
+        if (tcgetattr(STDIN_FILENO, &original) < 0) {
+            perror("tcgetattr()");
+            return;
+        }
+        struct termios raw = original;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_cc[VMIN] = 0;
+        raw.c_cc[VTIME] = 0;
+        if (tcsetattr(STDIN_FILENO, TCSANOW, &raw) < 0) {
+            perror("tcsetattr()");
+            return;
+        }
+        is_raw = true;
+        active_session = this;
 
-    ch = getchar();
+        for (int sig : {SIGINT, SIGTERM, SIGHUP, SIGQUIT}) {
+            signal(sig, handleSignal);
+        }
+        signal(SIGWINCH, handleResize);
+        const char clear_and_hide_cursor[] = "\033[2J\033[?25l";
+        if (write(STDOUT_FILENO, clear_and_hide_cursor, sizeof(clear_and_hide_cursor) - 1) < 0)
+            perror("write()");
+
+        const char* tty = ttyname(STDOUT_FILENO);
+        if (tty != nullptr) {
+            output_fd = open(tty, O_WRONLY | O_NONBLOCK | O_NOCTTY);
+        }
+    }
 
-    tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
-    fcntl(STDIN_FILENO, F_SETFL, oldf);
+    TerminalSession(const TerminalSession&) = delete;
+    TerminalSession& operator=(const TerminalSession&) = delete;
 
-    if (ch != EOF) {
-        ungetc(ch, stdin);
-        return true;
+    ~TerminalSession() {
+        restore();
+        if (output_fd >= 0) close(output_fd);
+        active_session = nullptr;
     }
 
-    return false;
-}
+    void restore() {
+        if (!is_raw) return;
+        is_raw = false;
+        signal(SIGWINCH, SIG_DFL);
+        tcsetattr(STDIN_FILENO, TCSADRAIN, &original);
+        const char show_cursor[] = "\033[?25h";
+        if (write(STDOUT_FILENO, show_cursor, sizeof(show_cursor) - 1) < 0)
+            perror("write()");
+    }
 
-char getch() {
-    char buf = 0;
-    struct termios old = {0};
-    if (tcgetattr(0, &old) < 0)
-        perror("tcsetattr()");
-    old.c_lflag &= ~ICANON;
-    old.c_lflag &= ~ECHO;
-    old.c_cc[VMIN] = 1;
-    old.c_cc[VTIME] = 0;
-    if (tcsetattr(0, TCSANOW, &old) < 0)
-        perror("tcsetattr ICANON");
-    if (read(0, &buf, 1) < 0)
-        perror("read()");
-    old.c_lflag |= ICANON;
-    old.c_lflag |= ECHO;
-    if (tcsetattr(0, TCSADRAIN, &old) < 0)
-        perror("tcsetattr ~ICANON");
-    return buf;
-}
+    // Returns -1 once stdin is at end of file or has failed.
+    int readKeys(char* keys, int max_keys) {
+        ssize_t count = read(STDIN_FILENO, keys, max_keys);
+        if (count < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+        return count > 0 ? static_cast<int>(count) : -1;
+    }
 
-class GameObject;
-class Player;
-class Enemy;
+    bool querySize(int& columns, int& rows) const {
+        struct winsize size;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) < 0 || size.ws_col == 0 || size.ws_row == 0) {
+            return false;
+        }
+        columns = size.ws_col;
+        rows = size.ws_row;
+        return true;
+    }
 
-enum class EventType {
-    EnemyHit,
-    PlayerHit
-};
+    // A separate non-blocking description of the tty, so frame writes can
+    // never stall the game loop; stdin keeps its own blocking flags.
+    int outputFd() const { return output_fd >= 0 ? output_fd : STDOUT_FILENO; }
 
-class Observer {
-public:
-    virtual ~Observer() = default;
-    virtual void onNotify(const GameObject& entity, EventType event) = 0;
+    bool takeResize() {
+        if (!resize_pending) return false;
+        resize_pending = 0;
+        return true;
+    }
 };
 
-class Subject {
+TerminalSession* TerminalSession::active_session = nullptr;
+volatile std::sig_atomic_t TerminalSession::resize_pending = 0;
+
+#ifndef SPACE_DEFENDER_NO_PROFILER
+class LatencyHistogram {
 private:
-    std::vector<Observer*> observers;
+    static constexpr int kSubBucketBits = 4;
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;
+
+    std::array<std::uint64_t, 64 * kSubBuckets> counts{};
+    std::uint64_t samples = 0;
+    std::uint64_t max_value = 0;
+
+    static int bucketOf(std::uint64_t value) {
+        if (value < kSubBuckets) return static_cast<int>(value);
+        int shift = 63 - __builtin_clzll(value) - kSubBucketBits;
+        return shift * kSubBuckets + static_cast<int>(value >> shift);
+    }
+
+    static std::uint64_t highestValueIn(int bucket) {
+        if (bucket < kSubBuckets) return bucket;
+        int shift = bucket / kSubBuckets - 1;
+        std::uint64_t mantissa = kSubBuckets + bucket % kSubBuckets;
+        return ((mantissa + 1) << shift) - 1;
+    }
 
 public:
-    void addObserver(Observer* observer) {
-        observers.push_back(observer);
+    void record(std::uint64_t value) {
+        counts[bucketOf(value)]++;
+        samples++;
+        max_value = std::max(max_value, value);
     }
 
-    void notify(const GameObject& entity, EventType event) {
-        for (auto obs : observers) {
-            obs->onNotify(entity, event);
+    std::uint64_t count() const { return samples; }
+    std::uint64_t max() const { return max_value; }
+
+    std::uint64_t percentile(double fraction) const {
+        if (samples == 0) return 0;
+        std::uint64_t rank = static_cast<std::uint64_t>(fraction * (samples - 1)) + 1;
+        std::uint64_t seen = 0;
+        for (std::size_t bucket = 0; bucket < counts.size(); ++bucket) {
+            seen += counts[bucket];
+            if (seen >= rank) {
+                return std::min(highestValueIn(static_cast<int>(bucket)), max_value);
+            }
         }
+        return max_value;
     }
 };
 
-class GameObject {
-protected:
-    int x, y;
-    char symbol;
-    bool is_active;
+enum class Phase {
+    Spawn,
+    Input,
+    Player,
+    Enemies,
+    Collision,
+    Compaction,
+    Events,
+    Draw,
+    Ui,
+    Present,
+    Count
+};
+
+class FrameProfiler {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static volatile std::sig_atomic_t dump_requested;
+
+    std::array<LatencyHistogram, static_cast<std::size_t>(Phase::Count)> phases;
+    LatencyHistogram frame_bytes;
+    Clock::time_point lap_start;
+    bool enabled = false;
+
+    FrameProfiler() = default;
+
+    static void requestDump(int) {
+        dump_requested = 1;
+    }
 
 public:
-    GameObject(int start_x, int start_y, char s) : x(start_x), y(start_y), symbol(s), is_active(true) {}
-    virtual ~GameObject() = default;
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator=(const FrameProfiler&) = delete;
 
-    int getX() const { return x; }
-    int getY() const { return y; }
-    char getSymbol() const { return symbol; }
-    bool active() const { return is_active; }
-    virtual void setActive(bool active) { is_active = active; }
+    static FrameProfiler& getInstance() {
+        static FrameProfiler instance;
+        return instance;
+    }
 
-    virtual void update() = 0;
-    virtual void draw() const {
-        if (is_active) {
-            std::cout << "\033[" << y << ";" << x << "H" << symbol;
+    static const char* phaseName(Phase phase) {
+        static const char* const names[] = {
+            "spawn", "input", "player", "enemies", "collision",
+            "compaction", "events", "draw", "ui", "present"
+        };
+        return names[static_cast<std::size_t>(phase)];
+    }
+
+    bool isEnabled() const { return enabled; }
+
+    void enable() {
+        enabled = true;
+        signal(SIGUSR1, requestDump);
+    }
+
+    void begin() {
+        if (enabled) lap_start = Clock::now();
+    }
+
+    void lap(Phase phase) {
+        if (!enabled) return;
+        Clock::time_point now = Clock::now();
+        phases[static_cast<std::size_t>(phase)].record(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now - lap_start).count());
+        lap_start = now;
+    }
+
+    void recordFrameBytes(std::uint64_t bytes) {
+        if (enabled) frame_bytes.record(bytes);
+    }
+
+    bool takeDumpRequest() {
+        if (!dump_requested) return false;
+        dump_requested = 0;
+        return true;
+    }
+
+    void print(std::FILE* out) const {
+        std::fprintf(out, "%-12s %10s %10s %10s %10s  (us)\n", "phase", "samples", "p50", "p99", "max");
+        for (std::size_t i = 0; i < phases.size(); ++i) {
+            const LatencyHistogram& histogram = phases[i];
+            if (histogram.count() == 0) continue;
+            std::fprintf(out, "%-12s %10llu %10.1f %10.1f %10.1f\n",
+                         phaseName(static_cast<Phase>(i)),
+                         static_cast<unsigned long long>(histogram.count()),
+                         histogram.percentile(0.50) / 1000.0,
+                         histogram.percentile(0.99) / 1000.0,
+                         histogram.max() / 1000.0);
+        }
+        if (frame_bytes.count() > 0) {
+            std::fprintf(out, "%-12s %10llu %10llu %10llu %10llu  (bytes)\n", "frame",
+                         static_cast<unsigned long long>(frame_bytes.count()),
+                         static_cast<unsigned long long>(frame_bytes.percentile(0.50)),
+                         static_cast<unsigned long long>(frame_bytes.percentile(0.99)),
+                         static_cast<unsigned long long>(frame_bytes.max()));
         }
+        std::fflush(out);
     }
 };
 
-class GameManager : public Observer {
+volatile std::sig_atomic_t FrameProfiler::dump_requested = 0;
+
+#define PROFILE_BEGIN() FrameProfiler::getInstance().begin()
+#define PROFILE_LAP(phase) FrameProfiler::getInstance().lap(phase)
+#define PROFILE_FRAME_BYTES(bytes) FrameProfiler::getInstance().recordFrameBytes(bytes)
+#define PROFILE_DUMP_IF_REQUESTED() \
+    do { \
+        if (FrameProfiler::getInstance().takeDumpRequest()) FrameProfiler::getInstance().print(stderr); \
+    } while (0)
+#else
+#define PROFILE_BEGIN() ((void)0)
+#define PROFILE_LAP(phase) ((void)0)
+#define PROFILE_FRAME_BYTES(bytes) ((void)0)
+#define PROFILE_DUMP_IF_REQUESTED() ((void)0)
+#endif
+
+template <typename T, std::size_t Capacity>
+class SpscRing {
 private:
-    static GameManager* instance;
-    int score;
-    bool game_over;
-    int screen_width, screen_height;
+    static_assert((Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
 
-    GameManager() : score(0), game_over(false), screen_width(64), screen_height(60) {}
+    std::array<T, Capacity> slots;
+    alignas(64) std::atomic<std::size_t> head{0};
+    alignas(64) std::atomic<std::size_t> tail{0};
 
 public:
-    GameManager(const GameManager&) = delete;
-    GameManager& operator=(const GameManager&) = delete;
+    bool push(const T& item) {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == Capacity) return false;
+        slots[t & (Capacity - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
 
-    static GameManager& getInstance() {
-        if (instance == nullptr) {
-            instance = new GameManager();
-        }
-        return *instance;
+    bool pop(T& item) {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        item = slots[h & (Capacity - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
     }
+};
 
-    void init() {
-        score = 0;
-        game_over = false;
-        std::cout << "\033[2J";
-        std::cout << "\033[?25l";
+class JobSystem {
+private:
+    using RangeFn = std::function<void(std::size_t, std::size_t)>;
+
+    struct Task {
+        std::size_t begin, end;
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    std::uint64_t generation = 0;
+    bool running = true;
+    const RangeFn* current = nullptr;
+    std::atomic<std::size_t> remaining{0};
+
+    bool popLocal(std::size_t self, Task& task) {
+        WorkQueue& queue = *queues[self];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        task = queue.tasks.back();
+        queue.tasks.pop_back();
+        return true;
     }
 
-    ~GameManager() {
-        std::cout << "\033[?25h";
+    bool steal(std::size_t self, Task& task) {
+        for (std::size_t k = 1; k < queues.size(); ++k) {
+            WorkQueue& victim = *queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.tasks.empty()) continue;
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            return true;
+        }
+        return false;
     }
 
-    bool isGameOver() const { return game_over; }
-    int getScore() const { return score; }
-    int getScreenWidth() const { return screen_width; }
-    int getScreenHeight() const { return screen_height; }
+    bool runOne(std::size_t self) {
+        Task task;
+        if (!popLocal(self, task) && !steal(self, task)) return false;
+        (*current)(task.begin, task.end);
+        remaining.fetch_sub(1, std::memory_order_acq_rel);
+        return true;
+    }
 
-    void addScore(int points) {
-        score += points;
+    void workerLoop(std::size_t self) {
+        std::uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(wake_mutex);
+                wake.wait(lock, [&] { return !running || generation != seen; });
+                if (!running) return;
+                seen = generation;
+            }
+            while (remaining.load(std::memory_order_acquire) > 0) {
+                if (!runOne(self)) std::this_thread::yield();
+            }
+        }
     }
 
-    void endGame() {
-        game_over = true;
+public:
+    explicit JobSystem(std::size_t thread_count) {
+        thread_count = std::max<std::size_t>(1, thread_count);
+        for (std::size_t i = 0; i < thread_count; ++i) {
+            queues.push_back(std::make_unique<WorkQueue>());
+        }
+        for (std::size_t i = 1; i < thread_count; ++i) {
+            workers.emplace_back(&JobSystem::workerLoop, this, i);
+        }
     }
 
-    void onNotify(const GameObject& entity, EventType event) override {
-        switch (event) {
-            case EventType::EnemyHit:
-                addScore(10);
-                break;
-            case EventType::PlayerHit:
-                endGame();
-                break;
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    ~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex);
+            running = false;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
         }
     }
 
-    void drawUI() {
-        std::cout << "\033[1;1H";
-        std::cout << "Score: " << score << " | Press 'q' to quit, 'f' to fire";
-        std::cout << std::flush;
-        if (game_over) {
-            std::cout << "\033[" << screen_height / 2 << ";" << (screen_width - 10) / 2 << "H";
-            std::cout << "GAME OVER!";
-            std::cout << "\033[" << screen_height / 2 + 1 << ";" << (screen_width - 15) / 2 << "H";
-            std::cout << "Final Score: " << score;
+    std::size_t threadCount() const { return queues.size(); }
+
+    static std::size_t chunkCount(std::size_t count, std::size_t grain) {
+        return (count + grain - 1) / grain;
+    }
+
+    void parallelFor(std::size_t count, std::size_t grain, const RangeFn& fn) {
+        if (count == 0) return;
+        std::size_t chunks = chunkCount(count, grain);
+        if (queues.size() == 1 || chunks == 1) {
+            for (std::size_t begin = 0; begin < count; begin += grain) {
+                fn(begin, std::min(count, begin + grain));
+            }
+            return;
+        }
+
+        current = &fn;
+        remaining.store(chunks, std::memory_order_release);
+        for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+            WorkQueue& queue = *queues[chunk % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(Task{chunk * grain, std::min(count, (chunk + 1) * grain)});
+        }
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex);
+            generation++;
+        }
+        wake.notify_all();
+
+        while (remaining.load(std::memory_order_acquire) > 0) {
+            if (!runOne(0)) std::this_thread::yield();
         }
     }
 };
 
-GameManager* GameManager::instance = nullptr;
+struct KeyEvent {
+    char key;
+    std::chrono::steady_clock::time_point time;
+};
 
-class Enemy : public GameObject, public Subject {
-protected:
-    int speed;
+struct TickInput {
+    int move = 0;
+    bool fire = false;
+    bool quit = false;
+    bool rewind = false;
+
+    void addKey(char key) {
+        switch (key) {
+            case 'a': move--; break;
+            case 'd': move++; break;
+            case 'f': fire = true; break;
+            case 'q': quit = true; break;
+            case 'r': rewind = true; break;
+        }
+    }
+};
+
+class InputReader {
+private:
+    TerminalSession& terminal;
+    SpscRing<KeyEvent, 256> ring;
+    std::atomic<bool> running;
+    std::atomic<long> dropped;
+    std::chrono::steady_clock::duration max_latency;
+    std::thread worker;
+
+    void run() {
+        struct pollfd stdin_poll = {STDIN_FILENO, POLLIN, 0};
+        char keys[64];
+        while (running.load(std::memory_order_relaxed)) {
+            if (poll(&stdin_poll, 1, 20) <= 0) continue;
+            if (stdin_poll.revents & (POLLERR | POLLNVAL)) break;
+            int key_count = terminal.readKeys(keys, sizeof(keys));
+            if (key_count < 0) break;
+            auto now = std::chrono::steady_clock::now();
+            for (int i = 0; i < key_count; ++i) {
+                if (!ring.push(KeyEvent{keys[i], now})) {
+                    dropped.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        }
+    }
 
 public:
-    Enemy(int x, int y, char s, int spd) : GameObject(x, y, s), speed(spd) {}
+    explicit InputReader(TerminalSession& session)
+        : terminal(session), running(true), dropped(0), max_latency(0), worker(&InputReader::run, this) {}
 
-    void update() override {
-        if (!is_active) return;
-        y += speed;
-        if (y > GameManager::getInstance().getScreenHeight()) {
-            is_active = false;
+    InputReader(const InputReader&) = delete;
+    InputReader& operator=(const InputReader&) = delete;
+
+    ~InputReader() {
+        running.store(false, std::memory_order_relaxed);
+        worker.join();
+    }
+
+    long droppedKeys() const { return dropped.load(std::memory_order_relaxed); }
+    std::chrono::steady_clock::duration maxLatency() const { return max_latency; }
+
+    TickInput drain() {
+        TickInput input;
+        KeyEvent event;
+        auto now = std::chrono::steady_clock::now();
+        while (ring.pop(event)) {
+            max_latency = std::max(max_latency, now - event.time);
+            input.addKey(event.key);
         }
+        return input;
     }
 };
 
-class FastEnemy : public Enemy {
-public:
-    FastEnemy(int x) : Enemy(x, 3, 'F', 2) {}
+struct FrameStats {
+    std::size_t bytes = 0;
+    int syscalls = 0;
 };
 
-class ToughEnemy : public Enemy {
+struct DecimalTable {
+    char digits[1000][3];
+    std::uint8_t length[1000];
+};
+
+constexpr DecimalTable makeDecimalTable() {
+    DecimalTable table{};
+    for (int n = 0; n < 1000; ++n) {
+        int length = n >= 100 ? 3 : n >= 10 ? 2 : 1;
+        for (int i = length - 1, value = n; i >= 0; --i, value /= 10) {
+            table.digits[n][i] = static_cast<char>('0' + value % 10);
+        }
+        table.length[n] = static_cast<std::uint8_t>(length);
+    }
+    return table;
+}
+
+constexpr DecimalTable kDecimal = makeDecimalTable();
+
+// Tracks where the terminal cursor is and reaches the next cell with the
+// fewest bytes: absolute CUP, CUU/CUD/CUF/CUB, CR or CR LF, or reprinting
+// the unchanged cells in between. Column 0 means the position is unknown.
+class CursorEncoder {
 private:
-    int health = 2;
+    int column = 0;
+    int row = 0;
 
-public:
-    ToughEnemy(int x) : Enemy(x, 3, 'T', 1) {}
+    static int digitCount(int n) {
+        return n < 1000 ? kDecimal.length[n] : static_cast<int>(std::to_string(n).size());
+    }
 
-    void setActive(bool active) {
-        if (active) {
-            is_active = true;
+    static void appendNumber(std::string& out, int n) {
+        if (n < 1000) {
+            out.append(kDecimal.digits[n], kDecimal.length[n]);
         } else {
-            health--;
-            if (health <= 0) {
-                is_active = false;
-                notify(*this, EventType::EnemyHit);
+            out += std::to_string(n);
+        }
+    }
+
+    static int absoluteCost(int x, int y) {
+        if (x == 1) return y == 1 ? 3 : 3 + digitCount(y);
+        return 4 + digitCount(y) + digitCount(x);
+    }
+
+    static void appendAbsolute(std::string& out, int x, int y) {
+        out += "\033[";
+        if (x != 1 || y != 1) {
+            appendNumber(out, y);
+            if (x != 1) {
+                out += ';';
+                appendNumber(out, x);
             }
         }
+        out += 'H';
     }
-};
 
-class EnemyFactory {
-private:
-    std::random_device rd;
-    std::mt19937 gen;
+    static int relativeCost(int n) {
+        return n == 1 ? 3 : 3 + digitCount(n);
+    }
 
-public:
-    EnemyFactory() : gen(rd()) {}
+    static void appendRelative(std::string& out, int n, char command) {
+        out += "\033[";
+        if (n != 1) appendNumber(out, n);
+        out += command;
+    }
+
+    static int horizontalCost(int from, int to) {
+        if (from == to) return 0;
+        int cost = relativeCost(std::abs(to - from));
+        if (to > from) cost = std::min(cost, to - from);
+        if (from != 1) cost = std::min(cost, 1 + horizontalCost(1, to));
+        return cost;
+    }
+
+    static void appendHorizontal(std::string& out, int from, int to, const char* row_text) {
+        if (from == to) return;
+        int relative = relativeCost(std::abs(to - from));
+        int reprint = to > from ? to - from : std::numeric_limits<int>::max();
+        int carriage = from != 1 ? 1 + horizontalCost(1, to) : std::numeric_limits<int>::max();
+        if (carriage < relative && carriage < reprint) {
+            out += '\r';
+            appendHorizontal(out, 1, to, row_text);
+        } else if (reprint <= relative) {
+            out.append(row_text + from - 1, to - from);
+        } else {
+            appendRelative(out, std::abs(to - from), to > from ? 'C' : 'D');
+        }
+    }
 
-    std::unique_ptr<Enemy> createRandomEnemy() {
-        std::uniform_int_distribution<> type_dist(0, 1);
-        std::uniform_int_distribution<> pos_dist(1, GameManager::getInstance().getScreenWidth() - 2);
+public:
+    void reset() {
+        column = 0;
+        row = 0;
+    }
 
-        int x = pos_dist(gen);
-        std::unique_ptr<Enemy> new_enemy;
+    // row_text is the target row as it will look on screen; cells left of x
+    // must already be final so they can be reprinted instead of skipped.
+    void moveTo(std::string& out, int x, int y, const char* row_text) {
+        if (column == x && row == y) return;
+        enum { Absolute, Relative, NewLines } plan = Absolute;
+        int best = absoluteCost(x, y);
+        if (column > 0) {
+            int cost = (y == row ? 0 : relativeCost(std::abs(y - row))) + horizontalCost(column, x);
+            if (cost < best) {
+                best = cost;
+                plan = Relative;
+            }
+            if (y > row && 2 * (y - row) + horizontalCost(1, x) < best) {
+                plan = NewLines;
+            }
+        }
 
-        switch (type_dist(gen)) {
-            case 0:
-                new_enemy = std::make_unique<FastEnemy>(x);
+        switch (plan) {
+            case Absolute:
+                appendAbsolute(out, x, y);
+                break;
+            case Relative:
+                if (y != row) appendRelative(out, std::abs(y - row), y > row ? 'B' : 'A');
+                appendHorizontal(out, column, x, row_text);
                 break;
-            case 1:
-                new_enemy = std::make_unique<ToughEnemy>(x);
+            case NewLines:
+                for (int i = row; i < y; ++i) {
+                    out += "\r\n";
+                }
+                appendHorizontal(out, 1, x, row_text);
                 break;
         }
+        column = x;
+        row = y;
+    }
 
-        new_enemy->addObserver(&GameManager::getInstance());
-        return new_enemy;
+    void advance(int width) {
+        column = column < width ? column + 1 : 0;
     }
 };
 
-class Bullet : public GameObject {
-public:
-    Bullet(int start_x, int start_y) : GameObject(start_x, start_y, '|') {}
+class FrameBuffer {
+private:
+    int width, height;
+    std::vector<char> current;
+    std::vector<char> previous;
+    std::string out;
+    int output_fd = STDOUT_FILENO;
+    FrameStats last_stats;
+    FrameStats total_stats;
+    FrameStats peak_stats;
+    long frames = 0;
+    long skipped = 0;
+    bool clear_pending = false;
+    std::string backlog;
+    CursorEncoder cursor;
+
+    static constexpr int kMaxQueuedBytes = 4096;
+
+    std::size_t writeSome(const char* data, std::size_t size) {
+        std::size_t done = 0;
+        while (done < size) {
+            ssize_t written = write(output_fd, data + done, size - done);
+            last_stats.syscalls++;
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                return size;
+            }
+            done += written;
+        }
+        return done;
+    }
 
-    void update() override {
-        if (!is_active) return;
-        y--;
-        if (y <= 1) {
-            is_active = false;
+    bool flushBacklog() {
+        if (!backlog.empty()) {
+            backlog.erase(0, writeSome(backlog.data(), backlog.size()));
         }
+        return backlog.empty();
     }
-};
 
-class Player : public GameObject, public Subject {
-private:
-    std::vector<std::unique_ptr<Bullet>> bullets;
-    int fire_cooldown;
+    bool congested() {
+        if (!flushBacklog()) return true;
+        int queued = 0;
+        return ioctl(output_fd, TIOCOUTQ, &queued) == 0 && queued > kMaxQueuedBytes;
+    }
+
+    void flushOutput() {
+        if (!backlog.empty()) {
+            backlog += out;
+            flushBacklog();
+            return;
+        }
+        std::size_t done = writeSome(out.data(), out.size());
+        if (done < out.size()) {
+            backlog.append(out, done, std::string::npos);
+        }
+    }
 
 public:
-    Player() : GameObject(32, 50, 'A'), fire_cooldown(0) {}
+    FrameBuffer(int w, int h) : width(w), height(h), current(w * h, ' '), previous(w * h, ' ') {
+        out.reserve(w * h * 8);
+    }
 
-    void update() override {
-        if (fire_cooldown > 0) {
-            fire_cooldown--;
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    void setOutput(int fd) { output_fd = fd; }
+    const FrameStats& lastStats() const { return last_stats; }
+    const FrameStats& peakStats() const { return peak_stats; }
+    const FrameStats& totalStats() const { return total_stats; }
+    long frameCount() const { return frames; }
+    long skippedFrames() const { return skipped; }
+
+    void clear() {
+        std::fill(current.begin(), current.end(), ' ');
+    }
+
+    void resize(int w, int h) {
+        width = w;
+        height = h;
+        current.assign(w * h, ' ');
+        previous.assign(w * h, ' ');
+        clear_pending = true;
+        cursor.reset();
+    }
+
+    void put(int x, int y, char c) {
+        if (x < 1 || x > width || y < 1 || y > height) return;
+        current[(y - 1) * width + (x - 1)] = c;
+    }
+
+    void text(int x, int y, const std::string& s) {
+        for (char c : s) {
+            put(x++, y, c);
+        }
+    }
+
+    bool present(bool allow_skip = true) {
+        out.clear();
+        last_stats = FrameStats();
+        if (allow_skip && congested()) {
+            skipped++;
+            return false;
+        }
+        if (clear_pending) {
+            out += "\033[2J";
+            clear_pending = false;
         }
-        
-        for (auto& bullet : bullets) {
-            bullet->update();
+        for (int row = 0; row < height; ++row) {
+            for (int col = 0; col < width; ++col) {
+                int i = row * width + col;
+                if (current[i] != previous[i]) {
+                    cursor.moveTo(out, col + 1, row + 1, &current[row * width]);
+                    out += current[i];
+                    cursor.advance(width);
+                }
+            }
         }
-        
-        bullets.erase(
-            std::remove_if(bullets.begin(), bullets.end(),
-                           [](const std::unique_ptr<Bullet>& b) { return !b->active(); }),
-            bullets.end()
-        );
+        flushOutput();
+        previous = current;
+
+        last_stats.bytes = out.size();
+        total_stats.bytes += last_stats.bytes;
+        total_stats.syscalls += last_stats.syscalls;
+        peak_stats.bytes = std::max(peak_stats.bytes, last_stats.bytes);
+        peak_stats.syscalls = std::max(peak_stats.syscalls, last_stats.syscalls);
+        frames++;
+        return true;
     }
 
-    void draw() const override {
-        GameObject::draw();
-        for (const auto& bullet : bullets) {
-            bullet->draw();
+    bool drain(int timeout_ms) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        while (!flushBacklog()) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0) return false;
+            struct pollfd output_poll = {output_fd, POLLOUT, 0};
+            poll(&output_poll, 1, static_cast<int>(left.count()));
         }
+        return true;
     }
+};
 
-    void moveLeft() {
-        if (x > 1) x--;
+class Viewport {
+private:
+    int left, top;
+    int width, height;
+
+public:
+    Viewport(int left_column, int top_row, int columns, int rows)
+        : left(left_column), top(top_row), width(columns), height(rows) {}
+
+    static Viewport following(int x, int y, int columns, int rows, int world_width, int world_height) {
+        constexpr int kBottomMargin = 2;
+        auto origin = [](int wanted, int view, int world) {
+            if (view >= world) return -(view - world) / 2;
+            return std::max(0, std::min(wanted, world - view));
+        };
+        return Viewport(origin(x - columns / 2, columns, world_width),
+                        origin(y + kBottomMargin - rows, rows, world_height), columns, rows);
     }
 
-    void moveRight() {
-        if (x < GameManager::getInstance().getScreenWidth() - 2) x++;
+    bool contains(int x, int y) const {
+        return x > left && x <= left + width && y > top && y <= top + height;
     }
 
-    void fire() {
-        if (fire_cooldown == 0) {
-            bullets.push_back(std::make_unique<Bullet>(x, y - 1));
-            fire_cooldown = 5;
+    void put(FrameBuffer& frame, int x, int y, char c) const {
+        if (contains(x, y)) {
+            frame.put(x - left, y - top, c);
         }
     }
+};
 
-    const std::vector<std::unique_ptr<Bullet>>& getBullets() const { return bullets; }
+class GameObject;
+class Player;
 
-    bool checkCollision(const GameObject& other) const {
-        return (active() && other.active() && x == other.getX() && y == other.getY());
-    }
+enum class EventType {
+    EnemyHit,
+    PlayerHit
 };
 
-int main() {
-    GameManager& game = GameManager::getInstance();
-    game.init();
+struct EnemyHandle {
+    std::uint32_t index = 0;
+    std::uint32_t generation = 0;
+};
 
-    EnemyFactory factory;
-    Player player;
-    player.addObserver(&game);
+struct GameEvent {
+    EventType type;
+    EnemyHandle enemy;
+    int x, y;
+    int points;
+};
 
-    std::vector<std::unique_ptr<Enemy>> enemies;
+class Observer {
+public:
+    virtual ~Observer() = default;
+    virtual void onNotify(const GameEvent& event) = 0;
+};
 
-    auto last_enemy_time = std::chrono::steady_clock::now();
+class EventQueue {
+private:
+    std::vector<GameEvent> pending;
+    std::vector<Observer*> subscribers;
 
-    while (!game.isGameOver()) {
-        std::cout << "\033[2J";
+public:
+    void subscribe(Observer* observer) {
+        subscribers.push_back(observer);
+    }
 
-        auto now = std::chrono::steady_clock::now();
-        if (std::chrono::duration_cast<std::chrono::milliseconds>(now - last_enemy_time).count() > 1500) {
-            enemies.push_back(factory.createRandomEnemy());
-            last_enemy_time = now;
-        }
+    void push(EventType type, EnemyHandle enemy, int x, int y, int points = 0) {
+        pending.push_back(GameEvent{type, enemy, x, y, points});
+    }
 
-        if (kbhit()) {
-            char key = getch();
-            switch (key) {
-                case 'a': player.moveLeft(); break;
-                case 'd': player.moveRight(); break;
-                case 'f': player.fire(); break;
-                case 'q': game.endGame(); break;
+    void dispatch() {
+        for (const GameEvent& event : pending) {
+            for (auto obs : subscribers) {
+                obs->onNotify(event);
             }
         }
+        pending.clear();
+    }
+};
 
-        player.update();
-        for (auto& enemy : enemies) {
-            enemy->update();
-        }
+bool sweptOverlap(int a_from, int a_to, int b_from, int b_to) {
+    int gap_from = a_from - b_from;
+    int gap_to = a_to - b_to;
+    return (gap_from <= 0 && gap_to >= 0) || (gap_from >= 0 && gap_to <= 0);
+}
 
-        for (auto& enemy : enemies) {
-            for (const auto& bullet : player.getBullets()) {
-                if (enemy->active() && bullet->active() && 
-                    enemy->getX() == bullet->getX() && enemy->getY() == bullet->getY()) {
-                    bullet->setActive(false);
-                    enemy->setActive(false);
-                }
-            }
-            if (player.checkCollision(*enemy)) {
-                player.notify(*enemy, EventType::PlayerHit);
-            }
-        }
+class GameObject {
+protected:
+    int x, y;
+    int prev_y;
+    char symbol;
+    bool is_active;
+
+public:
+    GameObject(int start_x, int start_y, char s) : x(start_x), y(start_y), prev_y(start_y), symbol(s), is_active(true) {}
+    virtual ~GameObject() = default;
 
-        enemies.erase(
-            std::remove_if(enemies.begin(), enemies.end(),
-                           [](const std::unique_ptr<Enemy>& e) { return !e->active(); }),
-            enemies.end()
-        );
+    int getX() const { return x; }
+    int getY() const { return y; }
+    int getPrevY() const { return prev_y; }
+    bool active() const { return is_active; }
 
-        player.draw();
-        for (auto& enemy : enemies) {
-            enemy->draw();
+    virtual void update() = 0;
+    virtual void draw(FrameBuffer& frame, const Viewport& view) const {
+        if (is_active) {
+            view.put(frame, x, y, symbol);
         }
-        game.drawUI();
-
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
     }
+};
+
+class GameManager : public Observer {
+private:
+    int score;
+    bool game_over;
+    int screen_width, screen_height;
+
+public:
+    GameManager(int width, int height) : score(0), game_over(false), screen_width(width), screen_height(height) {}
+
+    bool isGameOver() const { return game_over; }
+    int getScore() const { return score; }
+    int getScreenWidth() const { return screen_width; }
+    int getScreenHeight() const { return screen_height; }
+
+    void addScore(int points) {
+        score += points;
+    }
+
+    void endGame() {
+        game_over = true;
+    }
+
+    void restore(int restored_score, bool restored_game_over) {
+        score = restored_score;
+        game_over = restored_game_over;
+    }
+
+    void onNotify(const GameEvent& event) override {
+        switch (event.type) {
+            case EventType::EnemyHit:
+                addScore(event.points);
+                break;
+            case EventType::PlayerHit:
+                endGame();
+                break;
+        }
+    }
+
+    void drawUI(FrameBuffer& frame, bool can_rewind) const {
+        frame.text(1, 1, "Score: " + std::to_string(score) + " | Press 'q' to quit, 'f' to fire" +
+                             (can_rewind ? ", 'r' to rewind" : ""));
+        if (game_over) {
+            int columns = frame.getWidth();
+            int rows = frame.getHeight();
+            frame.text((columns - 10) / 2, rows / 2, "GAME OVER!");
+            frame.text((columns - 15) / 2, rows / 2 + 1, "Final Score: " + std::to_string(score));
+        }
+    }
+};
+
+enum class EnemyType : std::uint8_t {
+    Fast,
+    Tough
+};
+
+struct EnemyArchetype {
+    EnemyType type;
+    char symbol;
+    int speed;
+    int hit_points;
+    int score;
+};
+
+constexpr EnemyArchetype kEnemyArchetypes[] = {
+    {EnemyType::Fast,  'F', 2, 1, 0},
+    {EnemyType::Tough, 'T', 1, 2, 10},
+};
+
+constexpr int kEnemyArchetypeCount = static_cast<int>(sizeof(kEnemyArchetypes) / sizeof(kEnemyArchetypes[0]));
+
+constexpr const EnemyArchetype& archetypeOf(EnemyType type) {
+    return kEnemyArchetypes[static_cast<std::size_t>(type)];
+}
+
+template <std::size_t... I>
+constexpr bool archetypesMatchTypes(std::index_sequence<I...>) {
+    return ((static_cast<std::size_t>(kEnemyArchetypes[I].type) == I) && ...);
+}
+
+static_assert(archetypesMatchTypes(std::make_index_sequence<kEnemyArchetypeCount>()),
+              "kEnemyArchetypes must be listed in EnemyType order");
+
+enum class SimdLevel {
+    Scalar,
+    Sse41,
+    Avx2
+};
+
+const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Avx2: return "avx2";
+        case SimdLevel::Sse41: return "sse4.1";
+        default: return "scalar";
+    }
+}
+
+// Motion kernels advance whole arrays at once. Active flags are always 0 or 1;
+// inactive lanes keep their position so every level produces identical state.
+namespace motion {
+
+void advanceEnemiesScalar(int* ys, int* prev_ys, const int* speeds, std::uint8_t* active, std::size_t count, int limit) {
+    for (std::size_t i = 0; i < count; ++i) {
+        if (!active[i]) continue;
+        prev_ys[i] = ys[i];
+        ys[i] += speeds[i];
+        if (ys[i] > limit) {
+            active[i] = 0;
+        }
+    }
+}
+
+void advanceBulletsScalar(int* ys, int* prev_ys, std::uint8_t* active, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        if (!active[i]) continue;
+        prev_ys[i] = ys[i];
+        ys[i]--;
+        if (ys[i] <= 1) {
+            active[i] = 0;
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse4.1")))
+void advanceEnemiesSse41(int* ys, int* prev_ys, const int* speeds, std::uint8_t* active, std::size_t count, int limit) {
+    const __m128i limits = _mm_set1_epi32(limit);
+    const __m128i ones = _mm_set1_epi32(1);
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        std::int32_t flags;
+        std::memcpy(&flags, active + i, sizeof(flags));
+        __m128i mask = _mm_sub_epi32(_mm_setzero_si128(), _mm_cvtepu8_epi32(_mm_cvtsi32_si128(flags)));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ys + i));
+        __m128i prev = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev_ys + i));
+        __m128i speed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(speeds + i));
+        prev = _mm_blendv_epi8(prev, y, mask);
+        y = _mm_add_epi32(y, _mm_and_si128(speed, mask));
+        __m128i keep = _mm_and_si128(_mm_andnot_si128(_mm_cmpgt_epi32(y, limits), mask), ones);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(ys + i), y);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(prev_ys + i), prev);
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(keep, keep), keep);
+        flags = _mm_cvtsi128_si32(packed);
+        std::memcpy(active + i, &flags, sizeof(flags));
+    }
+    advanceEnemiesScalar(ys + i, prev_ys + i, speeds + i, active + i, count - i, limit);
+}
+
+__attribute__((target("sse4.1")))
+void advanceBulletsSse41(int* ys, int* prev_ys, std::uint8_t* active, std::size_t count) {
+    const __m128i ones = _mm_set1_epi32(1);
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        std::int32_t flags;
+        std::memcpy(&flags, active + i, sizeof(flags));
+        __m128i step = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(flags));
+        __m128i mask = _mm_sub_epi32(_mm_setzero_si128(), step);
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ys + i));
+        __m128i prev = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev_ys + i));
+        prev = _mm_blendv_epi8(prev, y, mask);
+        y = _mm_sub_epi32(y, step);
+        __m128i keep = _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi32(y, ones), mask), ones);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(ys + i), y);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(prev_ys + i), prev);
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(keep, keep), keep);
+        flags = _mm_cvtsi128_si32(packed);
+        std::memcpy(active + i, &flags, sizeof(flags));
+    }
+    advanceBulletsScalar(ys + i, prev_ys + i, active + i, count - i);
+}
+
+__attribute__((target("avx2")))
+inline void storeFlags8(std::uint8_t* active, __m256i keep) {
+    __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(keep), _mm256_extracti128_si256(keep, 1));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(active), _mm_packus_epi16(words, words));
+}
+
+__attribute__((target("avx2")))
+void advanceEnemiesAvx2(int* ys, int* prev_ys, const int* speeds, std::uint8_t* active, std::size_t count, int limit) {
+    const __m256i limits = _mm256_set1_epi32(limit);
+    const __m256i ones = _mm256_set1_epi32(1);
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i step = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(active + i)));
+        __m256i mask = _mm256_sub_epi32(_mm256_setzero_si256(), step);
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ys + i));
+        __m256i prev = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev_ys + i));
+        __m256i speed = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(speeds + i));
+        prev = _mm256_blendv_epi8(prev, y, mask);
+        y = _mm256_add_epi32(y, _mm256_and_si256(speed, mask));
+        __m256i keep = _mm256_and_si256(_mm256_andnot_si256(_mm256_cmpgt_epi32(y, limits), mask), ones);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(ys + i), y);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(prev_ys + i), prev);
+        storeFlags8(active + i, keep);
+    }
+    advanceEnemiesScalar(ys + i, prev_ys + i, speeds + i, active + i, count - i, limit);
+}
+
+__attribute__((target("avx2")))
+void advanceBulletsAvx2(int* ys, int* prev_ys, std::uint8_t* active, std::size_t count) {
+    const __m256i ones = _mm256_set1_epi32(1);
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i step = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(active + i)));
+        __m256i mask = _mm256_sub_epi32(_mm256_setzero_si256(), step);
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ys + i));
+        __m256i prev = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev_ys + i));
+        prev = _mm256_blendv_epi8(prev, y, mask);
+        y = _mm256_sub_epi32(y, step);
+        __m256i keep = _mm256_and_si256(_mm256_and_si256(_mm256_cmpgt_epi32(y, ones), mask), ones);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(ys + i), y);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(prev_ys + i), prev);
+        storeFlags8(active + i, keep);
+    }
+    advanceBulletsScalar(ys + i, prev_ys + i, active + i, count - i);
+}
+#endif
+
+}  // namespace motion
+
+struct MotionKernels {
+    using EnemyKernel = void (*)(int*, int*, const int*, std::uint8_t*, std::size_t, int);
+    using BulletKernel = void (*)(int*, int*, std::uint8_t*, std::size_t);
+
+    SimdLevel level;
+    EnemyKernel advance_enemies;
+    BulletKernel advance_bullets;
+
+    static SimdLevel detect() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return SimdLevel::Avx2;
+        if (__builtin_cpu_supports("sse4.1")) return SimdLevel::Sse41;
+#endif
+        return SimdLevel::Scalar;
+    }
+
+    static MotionKernels forLevel(SimdLevel level) {
+        SimdLevel supported = detect();
+        if (level > supported) level = supported;
+#if defined(__x86_64__) || defined(__i386__)
+        if (level == SimdLevel::Avx2) {
+            return MotionKernels{level, motion::advanceEnemiesAvx2, motion::advanceBulletsAvx2};
+        }
+        if (level == SimdLevel::Sse41) {
+            return MotionKernels{level, motion::advanceEnemiesSse41, motion::advanceBulletsSse41};
+        }
+#endif
+        return MotionKernels{SimdLevel::Scalar, motion::advanceEnemiesScalar, motion::advanceBulletsScalar};
+    }
+
+    static MotionKernels& current() {
+        static MotionKernels kernels = forLevel(detect());
+        return kernels;
+    }
+};
+
+class EnemyStore {
+private:
+    struct Slot {
+        std::uint32_t dense_index;
+        std::uint32_t generation;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<std::uint32_t> free_slots;
+
+    std::vector<std::uint32_t> slot_of;
+    std::vector<int> xs;
+    std::vector<int> ys;
+    std::vector<int> prev_ys;
+    std::vector<int> speeds;
+    std::vector<int> healths;
+    std::vector<EnemyType> types;
+    std::vector<std::uint8_t> active_flags;
+
+    void eraseAt(std::size_t i) {
+        std::size_t last = size() - 1;
+        Slot& erased = slots[slot_of[i]];
+        erased.generation++;
+        free_slots.push_back(slot_of[i]);
+
+        if (i != last) {
+            slot_of[i] = slot_of[last];
+            xs[i] = xs[last];
+            ys[i] = ys[last];
+            prev_ys[i] = prev_ys[last];
+            speeds[i] = speeds[last];
+            healths[i] = healths[last];
+            types[i] = types[last];
+            active_flags[i] = active_flags[last];
+            slots[slot_of[i]].dense_index = static_cast<std::uint32_t>(i);
+        }
+        slot_of.pop_back();
+        xs.pop_back();
+        ys.pop_back();
+        prev_ys.pop_back();
+        speeds.pop_back();
+        healths.pop_back();
+        types.pop_back();
+        active_flags.pop_back();
+    }
+
+public:
+    std::size_t size() const { return xs.size(); }
+    int getX(std::size_t i) const { return xs[i]; }
+    int getY(std::size_t i) const { return ys[i]; }
+    int getPrevY(std::size_t i) const { return prev_ys[i]; }
+    EnemyType getType(std::size_t i) const { return types[i]; }
+    int getHealth(std::size_t i) const { return healths[i]; }
+    bool active(std::size_t i) const { return active_flags[i] != 0; }
+
+    EnemyHandle handleAt(std::size_t i) const {
+        return EnemyHandle{slot_of[i], slots[slot_of[i]].generation};
+    }
+
+    bool contains(EnemyHandle handle) const {
+        return handle.index < slots.size() && slots[handle.index].generation == handle.generation;
+    }
+
+    bool find(EnemyHandle handle, std::size_t& i) const {
+        if (!contains(handle)) return false;
+        i = slots[handle.index].dense_index;
+        return true;
+    }
+
+    static constexpr int kSpawnRow = 3;
+
+    EnemyHandle spawn(EnemyType type, int x, int y = kSpawnRow) {
+        return spawn(archetypeOf(type), x, y);
+    }
+
+    EnemyHandle spawn(const EnemyArchetype& archetype, int x, int y = kSpawnRow) {
+        std::uint32_t slot;
+        if (free_slots.empty()) {
+            slot = static_cast<std::uint32_t>(slots.size());
+            slots.push_back(Slot{0, 0});
+        } else {
+            slot = free_slots.back();
+            free_slots.pop_back();
+        }
+        slots[slot].dense_index = static_cast<std::uint32_t>(size());
+
+        slot_of.push_back(slot);
+        xs.push_back(x);
+        ys.push_back(y);
+        prev_ys.push_back(y);
+        speeds.push_back(archetype.speed);
+        healths.push_back(archetype.hit_points);
+        types.push_back(archetype.type);
+        active_flags.push_back(1);
+        return EnemyHandle{slot, slots[slot].generation};
+    }
+
+    bool erase(EnemyHandle handle) {
+        std::size_t i;
+        if (!find(handle, i)) return false;
+        eraseAt(i);
+        return true;
+    }
+
+    // Keeps the slot table so handles issued before the clear stay stale.
+    void clear() {
+        for (std::uint32_t slot : slot_of) {
+            slots[slot].generation++;
+        }
+        free_slots.clear();
+        for (std::size_t slot = slots.size(); slot > 0; --slot) {
+            free_slots.push_back(static_cast<std::uint32_t>(slot - 1));
+        }
+        slot_of.clear();
+        xs.clear();
+        ys.clear();
+        prev_ys.clear();
+        speeds.clear();
+        healths.clear();
+        types.clear();
+        active_flags.clear();
+    }
+
+    void restore(EnemyType type, int x, int y, int prev_y, int health) {
+        spawn(type, x, y);
+        prev_ys.back() = prev_y;
+        healths.back() = health;
+    }
+
+    void update(int screen_height) {
+        update(screen_height, 0, size());
+    }
+
+    void update(int screen_height, std::size_t begin, std::size_t end) {
+        if (begin >= end) return;
+        MotionKernels::current().advance_enemies(ys.data() + begin, prev_ys.data() + begin, speeds.data() + begin,
+                                                 active_flags.data() + begin, end - begin, screen_height);
+    }
+
+    void hit(std::size_t i, EventQueue& events) {
+        if (--healths[i] > 0) return;
+        active_flags[i] = 0;
+        events.push(EventType::EnemyHit, handleAt(i), xs[i], ys[i], archetypeOf(types[i]).score);
+    }
+
+    std::size_t memoryBytes() const {
+        return slots.capacity() * sizeof(Slot) +
+               (free_slots.capacity() + slot_of.capacity()) * sizeof(std::uint32_t) +
+               (xs.capacity() + ys.capacity() + prev_ys.capacity() + speeds.capacity() + healths.capacity()) * sizeof(int) +
+               types.capacity() * sizeof(EnemyType) + active_flags.capacity();
+    }
+
+    void removeInactive() {
+        for (std::size_t i = size(); i > 0; --i) {
+            if (!active_flags[i - 1]) {
+                eraseAt(i - 1);
+            }
+        }
+    }
+
+    void draw(FrameBuffer& frame, const Viewport& view) const {
+        const std::size_t count = size();
+        for (std::size_t i = 0; i < count; ++i) {
+            if (active_flags[i]) {
+                view.put(frame, xs[i], ys[i], archetypeOf(types[i]).symbol);
+            }
+        }
+    }
+};
+
+class Rng {
+private:
+    std::uint64_t state;
+
+public:
+    explicit Rng(std::uint64_t seed) : state(seed) {}
+
+    std::uint64_t getState() const { return state; }
+
+    std::uint64_t next() {
+        std::uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    int uniform(int low, int high) {
+        std::uint64_t range = static_cast<std::uint64_t>(high - low) + 1;
+        return low + static_cast<int>(((next() >> 32) * range) >> 32);
+    }
+};
+
+class EnemyFactory {
+private:
+    Rng rng;
+    int width, height;
+
+public:
+    EnemyFactory(std::uint64_t seed, int world_width, int world_height)
+        : rng(seed), width(world_width), height(world_height) {}
+
+    std::uint64_t getRngState() const { return rng.getState(); }
+    void setRngState(std::uint64_t state) { rng = Rng(state); }
+
+    void createRandomEnemy(EnemyStore& enemies, bool scatter = false) {
+        int x = rng.uniform(1, width - 2);
+        EnemyType type = static_cast<EnemyType>(rng.uniform(0, kEnemyArchetypeCount - 1));
+        int y = scatter ? rng.uniform(EnemyStore::kSpawnRow, height) : EnemyStore::kSpawnRow;
+        enemies.spawn(type, x, y);
+    }
+};
+
+struct SpawnSchedule {
+    int wave_size = 1;
+    int wave_interval = 30;
+    double rate = 0.0;
+    double ramp_to_rate = 0.0;
+    long ramp_ticks = 0;
+    long target_enemies = 0;
+    long target_bullets = 0;
+    bool scatter = false;
+};
+
+class SpawnScheduler {
+private:
+    SpawnSchedule schedule;
+    double carry;
+
+public:
+    explicit SpawnScheduler(const SpawnSchedule& spawn_schedule) : schedule(spawn_schedule), carry(0.0) {}
+
+    const SpawnSchedule& getSchedule() const { return schedule; }
+    double getCarry() const { return carry; }
+    void setCarry(double restored_carry) { carry = restored_carry; }
+
+    double rateAt(long tick) const {
+        if (schedule.ramp_ticks <= 0) return schedule.rate;
+        double progress = std::min(1.0, static_cast<double>(tick) / schedule.ramp_ticks);
+        return schedule.rate + (schedule.ramp_to_rate - schedule.rate) * progress;
+    }
+
+    long enemiesDue(long tick, std::size_t live) {
+        long due = 0;
+        if (schedule.wave_interval > 0 && tick % schedule.wave_interval == schedule.wave_interval - 1) {
+            due += schedule.wave_size;
+        }
+        carry += rateAt(tick);
+        long whole = static_cast<long>(carry);
+        carry -= whole;
+        due += whole;
+        if (schedule.target_enemies > static_cast<long>(live)) {
+            due = std::max(due, schedule.target_enemies - static_cast<long>(live));
+        }
+        return due;
+    }
+
+    long bulletsDue(std::size_t live) const {
+        return std::max(0L, schedule.target_bullets - static_cast<long>(live));
+    }
+};
+
+constexpr std::size_t kMaxBulletCapacity = std::size_t(1) << 24;
+constexpr std::uint64_t kMaxWorldSide = 1 << 14;
+
+class BulletPool {
+private:
+    std::vector<int> xs;
+    std::vector<int> ys;
+    std::vector<int> prev_ys;
+    std::vector<std::uint8_t> active_flags;
+    std::size_t count;
+    std::size_t high_water;
+    long exhausted;
+
+public:
+    static constexpr char kSymbol = '|';
+
+    explicit BulletPool(std::size_t capacity)
+        : xs(capacity), ys(capacity), prev_ys(capacity), active_flags(capacity), count(0), high_water(0), exhausted(0) {}
+
+    std::size_t size() const { return count; }
+    std::size_t capacity() const { return xs.size(); }
+    std::size_t highWater() const { return high_water; }
+    long exhaustedCount() const { return exhausted; }
+
+    int getX(std::size_t i) const { return xs[i]; }
+    int getY(std::size_t i) const { return ys[i]; }
+    int getPrevY(std::size_t i) const { return prev_ys[i]; }
+    bool active(std::size_t i) const { return active_flags[i] != 0; }
+    void deactivate(std::size_t i) { active_flags[i] = 0; }
+
+    bool acquire(int x, int y) {
+        if (count == capacity()) {
+            exhausted++;
+            return false;
+        }
+        xs[count] = x;
+        ys[count] = y;
+        prev_ys[count] = y;
+        active_flags[count] = 1;
+        count++;
+        high_water = std::max(high_water, count);
+        return true;
+    }
+
+    void clear() {
+        count = 0;
+    }
+
+    bool restore(int x, int y, int prev_y, bool active) {
+        if (!acquire(x, y)) return false;
+        prev_ys[count - 1] = prev_y;
+        active_flags[count - 1] = active ? 1 : 0;
+        return true;
+    }
+
+    void update(std::size_t begin, std::size_t end) {
+        if (begin >= end) return;
+        MotionKernels::current().advance_bullets(ys.data() + begin, prev_ys.data() + begin,
+                                                 active_flags.data() + begin, end - begin);
+    }
+
+    std::size_t memoryBytes() const {
+        return (xs.capacity() + ys.capacity() + prev_ys.capacity()) * sizeof(int) + active_flags.capacity();
+    }
+
+    void releaseInactive() {
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            if (!active_flags[i]) continue;
+            xs[kept] = xs[i];
+            ys[kept] = ys[i];
+            prev_ys[kept] = prev_ys[i];
+            active_flags[kept] = 1;
+            kept++;
+        }
+        count = kept;
+    }
+
+    void draw(FrameBuffer& frame, const Viewport& view) const {
+        for (std::size_t i = 0; i < count; ++i) {
+            if (active_flags[i]) {
+                view.put(frame, xs[i], ys[i], kSymbol);
+            }
+        }
+    }
+};
+
+class Player : public GameObject {
+public:
+    static constexpr int kFireCooldown = 5;
+
+private:
+    BulletPool bullets;
+    int fire_cooldown;
+    int max_x;
+
+public:
+    // Starts centred, ten rows above the bottom: (32, 50) in the default 64x60 world.
+    Player(std::size_t bullet_capacity, int world_width, int world_height)
+        : GameObject(world_width / 2, std::max(2, world_height - 10), 'A'), bullets(bullet_capacity), fire_cooldown(0),
+          max_x(world_width - 2) {}
+
+    void update() override {
+        update(nullptr, 0);
+    }
+
+    void update(JobSystem* jobs, std::size_t grain) {
+        if (fire_cooldown > 0) {
+            fire_cooldown--;
+        }
+
+        if (jobs != nullptr) {
+            jobs->parallelFor(bullets.size(), grain, [this](std::size_t begin, std::size_t end) {
+                bullets.update(begin, end);
+            });
+        } else {
+            bullets.update(0, bullets.size());
+        }
+        bullets.releaseInactive();
+    }
+
+    void draw(FrameBuffer& frame, const Viewport& view) const override {
+        GameObject::draw(frame, view);
+        bullets.draw(frame, view);
+    }
+
+    void moveLeft() {
+        if (x > 1) x--;
+    }
+
+    void moveRight() {
+        if (x < max_x) x++;
+    }
+
+    void fire() {
+        if (fire_cooldown == 0 && bullets.acquire(x, y - 1)) {
+            fire_cooldown = kFireCooldown;
+        }
+    }
+
+    int getFireCooldown() const { return fire_cooldown; }
+
+    void restore(int restored_x, int restored_cooldown) {
+        x = restored_x;
+        fire_cooldown = restored_cooldown;
+    }
+
+    BulletPool& getBullets() { return bullets; }
+    const BulletPool& getBullets() const { return bullets; }
+
+    bool checkCollision(const EnemyStore& enemies, std::size_t i) const {
+        return (active() && enemies.active(i) && x == enemies.getX(i) &&
+                sweptOverlap(prev_y, y, enemies.getPrevY(i), enemies.getY(i)));
+    }
+};
+
+std::uint64_t zigzag(std::int64_t value) {
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t value) {
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+void appendVarint(std::string& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+bool takeVarint(const char*& data, const char* end, std::uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && data < end; shift += 7) {
+        std::uint8_t byte = static_cast<std::uint8_t>(*data++);
+        value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+void appendFixed64(std::string& out, std::uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out += static_cast<char>(value >> (8 * i));
+    }
+}
+
+bool takeFixed64(const char*& data, const char* end, std::uint64_t& value) {
+    if (end - data < 8) return false;
+    value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value |= static_cast<std::uint64_t>(static_cast<std::uint8_t>(*data++)) << (8 * i);
+    }
+    return true;
+}
+
+std::uint64_t doubleBits(double value) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double bitsToDouble(std::uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+enum class CollisionMode {
+    Grid,
+    Naive
+};
+
+struct WorldConfig {
+    std::uint64_t seed = 0;
+    int width = 64;
+    int height = 60;
+    CollisionMode collision_mode = CollisionMode::Grid;
+    std::size_t bullet_capacity = 64;
+    SpawnSchedule spawn;
+    JobSystem* jobs = nullptr;
+    bool profiled = true;
+};
+
+// Everything besides the seed that changes how a game plays out; replay and
+// snapshot headers both start with it. Collision mode and jobs are kept.
+void appendWorldConfig(std::string& out, const WorldConfig& config) {
+    const SpawnSchedule& spawn = config.spawn;
+    appendVarint(out, config.seed);
+    appendVarint(out, config.width);
+    appendVarint(out, config.height);
+    appendVarint(out, config.bullet_capacity);
+    appendVarint(out, spawn.wave_size);
+    appendVarint(out, spawn.wave_interval);
+    appendFixed64(out, doubleBits(spawn.rate));
+    appendFixed64(out, doubleBits(spawn.ramp_to_rate));
+    appendVarint(out, spawn.ramp_ticks);
+    appendVarint(out, spawn.target_enemies);
+    appendVarint(out, spawn.target_bullets);
+    out += static_cast<char>(spawn.scatter);
+}
+
+bool validSpawnRate(double rate, std::uint64_t cells) {
+    return std::isfinite(rate) && rate >= 0.0 && rate <= static_cast<double>(cells);
+}
+
+// Rejects anything that would not fit in memory or would overflow the spawn
+// arithmetic: counts per tick are capped at one per world cell.
+bool takeWorldConfig(const char*& data, const char* end, WorldConfig& config) {
+    std::uint64_t seed, width, height, capacity, wave_size, wave_interval, rate, ramp_to_rate, ramp_ticks,
+        target_enemies, target_bullets;
+    if (!takeVarint(data, end, seed) || !takeVarint(data, end, width) ||
+        !takeVarint(data, end, height) || !takeVarint(data, end, capacity) ||
+        !takeVarint(data, end, wave_size) || !takeVarint(data, end, wave_interval) ||
+        !takeFixed64(data, end, rate) || !takeFixed64(data, end, ramp_to_rate) ||
+        !takeVarint(data, end, ramp_ticks) || !takeVarint(data, end, target_enemies) ||
+        !takeVarint(data, end, target_bullets) || data == end ||
+        width < 4 || height < 4 || width > kMaxWorldSide || height > kMaxWorldSide) {
+        return false;
+    }
+    std::uint64_t cells = width * height;
+    if (capacity == 0 || capacity > kMaxBulletCapacity || wave_size > cells ||
+        wave_interval > static_cast<std::uint64_t>(std::numeric_limits<int>::max()) ||
+        !validSpawnRate(bitsToDouble(rate), cells) || !validSpawnRate(bitsToDouble(ramp_to_rate), cells) ||
+        ramp_ticks > static_cast<std::uint64_t>(std::numeric_limits<long>::max()) ||
+        target_enemies > cells || target_bullets > cells) {
+        return false;
+    }
+    config.seed = seed;
+    config.width = static_cast<int>(width);
+    config.height = static_cast<int>(height);
+    config.bullet_capacity = capacity;
+    config.spawn.wave_size = static_cast<int>(wave_size);
+    config.spawn.wave_interval = static_cast<int>(wave_interval);
+    config.spawn.rate = bitsToDouble(rate);
+    config.spawn.ramp_to_rate = bitsToDouble(ramp_to_rate);
+    config.spawn.ramp_ticks = static_cast<long>(ramp_ticks);
+    config.spawn.target_enemies = static_cast<long>(target_enemies);
+    config.spawn.target_bullets = static_cast<long>(target_bullets);
+    config.spawn.scatter = *data++ != 0;
+    return true;
+}
+
+namespace replay_format {
+    constexpr char kMagic[4] = {'S', 'D', 'R', 'P'};
+    constexpr int kVersion = 3;
+
+    constexpr int kFire = 1;
+    constexpr int kQuit = 2;
+    constexpr int kMove = 4;
+    constexpr int kEnd = 8;
+}
+
+class InputRecorder {
+private:
+    std::ofstream out;
+    long last_tick;
+
+public:
+    InputRecorder() : last_tick(0) {}
+
+    bool open(const std::string& path, const WorldConfig& config) {
+        out.open(path, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        std::string header(replay_format::kMagic, sizeof(replay_format::kMagic));
+        header += static_cast<char>(replay_format::kVersion);
+        appendWorldConfig(header, config);
+        out.write(header.data(), header.size());
+        return static_cast<bool>(out);
+    }
+
+    bool isOpen() const { return out.is_open(); }
+
+    void record(long tick, const TickInput& input) {
+        if (!out.is_open()) return;
+        int flags = (input.fire ? replay_format::kFire : 0) |
+                    (input.quit ? replay_format::kQuit : 0) |
+                    (input.move != 0 ? replay_format::kMove : 0);
+        if (flags == 0) return;
+
+        std::string entry;
+        appendVarint(entry, tick - last_tick);
+        entry += static_cast<char>(flags);
+        if (input.move != 0) {
+            appendVarint(entry, zigzag(input.move));
+        }
+        out.write(entry.data(), entry.size());
+        last_tick = tick;
+    }
+
+    void finish(long tick) {
+        if (!out.is_open()) return;
+        std::string entry;
+        appendVarint(entry, tick - last_tick);
+        entry += static_cast<char>(replay_format::kEnd);
+        out.write(entry.data(), entry.size());
+        out.close();
+    }
+};
+
+class InputReplay {
+private:
+    struct Entry {
+        long tick;
+        TickInput input;
+    };
+
+    std::vector<Entry> entries;
+    std::size_t cursor;
+    long end_tick;
+
+public:
+    InputReplay() : cursor(0), end_tick(-1) {}
+
+    // The recorded seed, world size, bullet pool and spawn schedule replace
+    // those in config.
+    bool load(const std::string& path, WorldConfig& config) {
+        std::ifstream file(path, std::ios::binary);
+        std::string in((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        const char* data = in.data();
+        const char* end = data + in.size();
+        if (in.size() <= sizeof(replay_format::kMagic) ||
+            !std::equal(data, data + sizeof(replay_format::kMagic), replay_format::kMagic) ||
+            data[sizeof(replay_format::kMagic)] != replay_format::kVersion) {
+            return false;
+        }
+        data += sizeof(replay_format::kMagic) + 1;
+        if (!takeWorldConfig(data, end, config)) return false;
+
+        long tick = 0;
+        std::uint64_t delta;
+        while (takeVarint(data, end, delta) && data < end) {
+            int flags = static_cast<std::uint8_t>(*data++);
+            tick += static_cast<long>(delta);
+            if (flags & replay_format::kEnd) {
+                end_tick = tick;
+                break;
+            }
+
+            Entry entry{tick, TickInput()};
+            entry.input.fire = (flags & replay_format::kFire) != 0;
+            entry.input.quit = (flags & replay_format::kQuit) != 0;
+            if (flags & replay_format::kMove) {
+                std::uint64_t encoded;
+                if (!takeVarint(data, end, encoded)) break;
+                entry.input.move = static_cast<int>(unzigzag(encoded));
+            }
+            entries.push_back(entry);
+        }
+        return true;
+    }
+
+    bool finished(long tick) const {
+        return end_tick >= 0 ? tick >= end_tick : cursor >= entries.size();
+    }
+
+    TickInput inputFor(long tick) {
+        while (cursor < entries.size() && entries[cursor].tick < tick) {
+            cursor++;
+        }
+        if (cursor < entries.size() && entries[cursor].tick == tick) {
+            return entries[cursor++].input;
+        }
+        return TickInput();
+    }
+};
+
+class CollisionGrid {
+private:
+    int width, height;
+    std::vector<int> cell_head;
+    std::vector<int> next_in_cell;
+    std::vector<int> occupied_cells;
+
+    int cellIndex(int x, int y) const {
+        if (x < 1 || x > width || y < 1 || y > height) return -1;
+        return (y - 1) * width + (x - 1);
+    }
+
+public:
+    CollisionGrid(int w, int h) : width(w), height(h), cell_head(static_cast<std::size_t>(w) * h, -1) {}
+
+    std::size_t memoryBytes() const {
+        return (cell_head.capacity() + next_in_cell.capacity() + occupied_cells.capacity()) * sizeof(int);
+    }
+
+    void rebuild(const BulletPool& bullets) {
+        for (int cell : occupied_cells) {
+            cell_head[cell] = -1;
+        }
+        occupied_cells.clear();
+        next_in_cell.assign(bullets.size(), -1);
+
+        for (int i = static_cast<int>(bullets.size()) - 1; i >= 0; --i) {
+            int cell = cellIndex(bullets.getX(i), bullets.getY(i));
+            if (!bullets.active(i) || cell < 0) continue;
+            if (cell_head[cell] < 0) {
+                occupied_cells.push_back(cell);
+            }
+            next_in_cell[i] = cell_head[cell];
+            cell_head[cell] = i;
+        }
+    }
+
+    template <typename Visitor>
+    void forEachInColumn(int x, int from_y, int to_y, Visitor&& visit) const {
+        for (int y = std::max(from_y, 1); y <= std::min(to_y, height); ++y) {
+            int cell = cellIndex(x, y);
+            if (cell < 0) return;
+            for (int i = cell_head[cell]; i >= 0; i = next_in_cell[i]) {
+                visit(i);
+            }
+        }
+    }
+};
+
+// Fixed-capacity copy of everything World::step reads, so search nodes can be
+// cloned with a plain struct copy. Enemy handles are reissued on restore.
+struct GameSnapshot {
+    static constexpr int kMaxEnemies = 128;
+    static constexpr int kMaxBullets = 32;
+
+    struct Enemy {
+        std::int16_t x, y, prev_y;
+        std::uint8_t type, health;
+    };
+
+    struct Bullet {
+        std::int16_t x, y, prev_y;
+        std::uint8_t active;
+    };
+
+    long tick;
+    std::uint64_t factory_rng;
+    std::uint64_t bullet_rng;
+    double spawn_carry;
+    std::int32_t score;
+    std::int16_t player_x;
+    std::uint8_t fire_cooldown;
+    std::uint8_t game_over;
+    std::uint16_t enemy_count;
+    std::uint16_t bullet_count;
+    Enemy enemies[kMaxEnemies];
+    Bullet bullets[kMaxBullets];
+};
+
+static_assert(std::is_trivially_copyable<GameSnapshot>::value, "GameSnapshot must stay a flat struct");
+
+struct CollisionCandidate {
+    std::uint32_t enemy;
+    std::int32_t bullet;
+};
+
+constexpr std::int32_t kPlayerCandidate = -1;
+
+class World {
+private:
+    std::uint64_t seed;
+    GameManager game;
+    EnemyFactory factory;
+    SpawnScheduler spawner;
+    Rng bullet_rng;
+    Player player;
+    EnemyStore enemies;
+    EventQueue events;
+    CollisionMode collision_mode;
+    bool profiled;
+    CollisionGrid bullet_grid;
+    std::vector<int> candidates;
+    JobSystem* jobs;
+    std::vector<std::vector<CollisionCandidate>> chunk_candidates;
+    long tick;
+
+    static constexpr int kBulletTravel = 1;
+    static constexpr std::size_t kParallelGrain = 16384;
+
+    void resolveHit(std::size_t enemy, std::size_t bullet) {
+        BulletPool& bullets = player.getBullets();
+        if (enemies.active(enemy) && bullets.active(bullet) && enemies.getX(enemy) == bullets.getX(bullet) &&
+            sweptOverlap(enemies.getPrevY(enemy), enemies.getY(enemy), bullets.getPrevY(bullet), bullets.getY(bullet))) {
+            bullets.deactivate(bullet);
+            enemies.hit(enemy, events);
+        }
+    }
+
+    void collideNaive() {
+        const std::size_t count = enemies.size();
+        for (std::size_t enemy = 0; enemy < count; ++enemy) {
+            const std::size_t bullet_count = player.getBullets().size();
+            for (std::size_t i = 0; i < bullet_count; ++i) {
+                resolveHit(enemy, i);
+            }
+            if (player.checkCollision(enemies, enemy)) {
+                events.push(EventType::PlayerHit, enemies.handleAt(enemy), enemies.getX(enemy), enemies.getY(enemy));
+            }
+        }
+    }
+
+    bool parallel(std::size_t count) const {
+        return jobs != nullptr && jobs->threadCount() > 1 && count > kParallelGrain;
+    }
+
+    void collideGridParallel() {
+        BulletPool& bullets = player.getBullets();
+        bullet_grid.rebuild(bullets);
+        const std::size_t count = enemies.size();
+        std::size_t chunks = JobSystem::chunkCount(count, kParallelGrain);
+        if (chunk_candidates.size() < chunks) {
+            chunk_candidates.resize(chunks);
+        }
+
+        jobs->parallelFor(count, kParallelGrain, [&](std::size_t begin, std::size_t end) {
+            std::vector<CollisionCandidate>& found = chunk_candidates[begin / kParallelGrain];
+            found.clear();
+            for (std::size_t enemy = begin; enemy < end; ++enemy) {
+                if (!enemies.active(enemy)) continue;
+                int x = enemies.getX(enemy);
+                int prev_y = enemies.getPrevY(enemy);
+                int y = enemies.getY(enemy);
+                std::size_t first = found.size();
+                bullet_grid.forEachInColumn(x, std::min(prev_y, y) - kBulletTravel, std::max(prev_y, y) + kBulletTravel, [&](int i) {
+                    if (bullets.getX(i) == x && sweptOverlap(prev_y, y, bullets.getPrevY(i), bullets.getY(i))) {
+                        found.push_back(CollisionCandidate{static_cast<std::uint32_t>(enemy), i});
+                    }
+                });
+                std::sort(found.begin() + first, found.end(), [](const CollisionCandidate& a, const CollisionCandidate& b) {
+                    return a.bullet < b.bullet;
+                });
+                if (player.checkCollision(enemies, enemy)) {
+                    found.push_back(CollisionCandidate{static_cast<std::uint32_t>(enemy), kPlayerCandidate});
+                }
+            }
+        });
+
+        for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+            for (const CollisionCandidate& candidate : chunk_candidates[chunk]) {
+                if (candidate.bullet != kPlayerCandidate) {
+                    resolveHit(candidate.enemy, static_cast<std::size_t>(candidate.bullet));
+                } else if (player.checkCollision(enemies, candidate.enemy)) {
+                    events.push(EventType::PlayerHit, enemies.handleAt(candidate.enemy),
+                                enemies.getX(candidate.enemy), enemies.getY(candidate.enemy));
+                }
+            }
+        }
+    }
+
+    void collideGrid() {
+        if (parallel(enemies.size())) {
+            collideGridParallel();
+            return;
+        }
+        BulletPool& bullets = player.getBullets();
+        bullet_grid.rebuild(bullets);
+        const std::size_t count = enemies.size();
+        for (std::size_t enemy = 0; enemy < count; ++enemy) {
+            if (!enemies.active(enemy)) continue;
+            int from_y = std::min(enemies.getPrevY(enemy), enemies.getY(enemy)) - kBulletTravel;
+            int to_y = std::max(enemies.getPrevY(enemy), enemies.getY(enemy)) + kBulletTravel;
+            candidates.clear();
+            bullet_grid.forEachInColumn(enemies.getX(enemy), from_y, to_y, [&](int i) {
+                candidates.push_back(i);
+            });
+            std::sort(candidates.begin(), candidates.end());
+            for (int i : candidates) {
+                resolveHit(enemy, static_cast<std::size_t>(i));
+            }
+            if (player.checkCollision(enemies, enemy)) {
+                events.push(EventType::PlayerHit, enemies.handleAt(enemy), enemies.getX(enemy), enemies.getY(enemy));
+            }
+        }
+    }
+
+public:
+    explicit World(const WorldConfig& config)
+        : seed(config.seed), game(config.width, config.height), factory(config.seed, config.width, config.height), spawner(config.spawn),
+          bullet_rng(config.seed ^ 0xB5AD4ECEDA1CE2A9ULL), player(config.bullet_capacity, config.width, config.height),
+          collision_mode(config.collision_mode), profiled(config.profiled),
+          bullet_grid(config.width, config.height), jobs(config.jobs), tick(0) {
+        events.subscribe(&game);
+    }
+
+    // Copies get their own event subscription; everything else is plain state.
+    World(const World& other)
+        : seed(other.seed), game(other.game), factory(other.factory), spawner(other.spawner), bullet_rng(other.bullet_rng),
+          player(other.player), enemies(other.enemies), collision_mode(other.collision_mode), profiled(other.profiled),
+          bullet_grid(other.bullet_grid), jobs(other.jobs), tick(other.tick) {
+        events.subscribe(&game);
+    }
+
+    World& operator=(const World&) = delete;
+
+    GameManager& getGame() { return game; }
+    const GameManager& getGame() const { return game; }
+
+    WorldConfig getConfig() const {
+        WorldConfig config;
+        config.seed = seed;
+        config.width = game.getScreenWidth();
+        config.height = game.getScreenHeight();
+        config.collision_mode = collision_mode;
+        config.profiled = profiled;
+        config.bullet_capacity = player.getBullets().capacity();
+        config.spawn = spawner.getSchedule();
+        config.jobs = jobs;
+        return config;
+    }
+    const Player& getPlayer() const { return player; }
+    bool isGameOver() const { return game.isGameOver(); }
+
+    bool capture(GameSnapshot& snapshot) const {
+        const BulletPool& bullets = player.getBullets();
+        if (enemies.size() > GameSnapshot::kMaxEnemies || bullets.size() > GameSnapshot::kMaxBullets ||
+            game.getScreenWidth() > std::numeric_limits<std::int16_t>::max() ||
+            game.getScreenHeight() > std::numeric_limits<std::int16_t>::max()) {
+            return false;
+        }
+        snapshot.tick = tick;
+        snapshot.factory_rng = factory.getRngState();
+        snapshot.bullet_rng = bullet_rng.getState();
+        snapshot.spawn_carry = spawner.getCarry();
+        snapshot.score = game.getScore();
+        snapshot.player_x = static_cast<std::int16_t>(player.getX());
+        snapshot.fire_cooldown = static_cast<std::uint8_t>(player.getFireCooldown());
+        snapshot.game_over = game.isGameOver();
+        snapshot.enemy_count = static_cast<std::uint16_t>(enemies.size());
+        for (std::size_t i = 0; i < enemies.size(); ++i) {
+            snapshot.enemies[i] = GameSnapshot::Enemy{
+                static_cast<std::int16_t>(enemies.getX(i)), static_cast<std::int16_t>(enemies.getY(i)),
+                static_cast<std::int16_t>(enemies.getPrevY(i)), static_cast<std::uint8_t>(enemies.getType(i)),
+                static_cast<std::uint8_t>(enemies.getHealth(i))};
+        }
+        snapshot.bullet_count = static_cast<std::uint16_t>(bullets.size());
+        for (std::size_t i = 0; i < bullets.size(); ++i) {
+            snapshot.bullets[i] = GameSnapshot::Bullet{
+                static_cast<std::int16_t>(bullets.getX(i)), static_cast<std::int16_t>(bullets.getY(i)),
+                static_cast<std::int16_t>(bullets.getPrevY(i)), bullets.active(i)};
+        }
+        return true;
+    }
+
+    // Unlike GameSnapshot this has no capacity limits: varints, with each
+    // prev_y stored as a zigzag delta from y. Only dynamic state is written;
+    // the WorldConfig it was taken under is the caller's to keep.
+    void serialize(std::string& out) const {
+        const BulletPool& bullets = player.getBullets();
+        appendVarint(out, tick);
+        appendFixed64(out, factory.getRngState());
+        appendFixed64(out, bullet_rng.getState());
+        appendFixed64(out, doubleBits(spawner.getCarry()));
+        appendVarint(out, zigzag(game.getScore()));
+        out += static_cast<char>(game.isGameOver());
+        appendVarint(out, zigzag(player.getX()));
+        appendVarint(out, player.getFireCooldown());
+
+        appendVarint(out, enemies.size());
+        for (std::size_t i = 0; i < enemies.size(); ++i) {
+            out += static_cast<char>(enemies.getType(i));
+            appendVarint(out, zigzag(enemies.getX(i)));
+            appendVarint(out, zigzag(enemies.getY(i)));
+            appendVarint(out, zigzag(enemies.getPrevY(i) - enemies.getY(i)));
+            appendVarint(out, zigzag(enemies.getHealth(i)));
+        }
+        appendVarint(out, bullets.size());
+        for (std::size_t i = 0; i < bullets.size(); ++i) {
+            appendVarint(out, zigzag(bullets.getX(i)));
+            appendVarint(out, zigzag(bullets.getY(i)));
+            appendVarint(out, zigzag(bullets.getPrevY(i) - bullets.getY(i)));
+            out += static_cast<char>(bullets.active(i));
+        }
+    }
+
+    // On failure the world is left partially restored and should be discarded.
+    // Everything read is checked against what step() can produce, so a
+    // crafted file cannot push coordinates or counters towards overflow.
+    bool deserialize(const char*& data, const char* end) {
+        std::uint64_t restored_tick, factory_state, bullet_state, carry_bits, score, x, cooldown, count;
+        if (!takeVarint(data, end, restored_tick) || !takeFixed64(data, end, factory_state) ||
+            !takeFixed64(data, end, bullet_state) || !takeFixed64(data, end, carry_bits) ||
+            !takeVarint(data, end, score) || data == end) {
+            return false;
+        }
+        bool restored_game_over = *data++ != 0;
+        if (!takeVarint(data, end, x) || !takeVarint(data, end, cooldown)) return false;
+
+        const int width = game.getScreenWidth();
+        const int height = game.getScreenHeight();
+        auto within = [](std::int64_t value, std::int64_t low, std::int64_t high) {
+            return value >= low && value <= high;
+        };
+        double carry = bitsToDouble(carry_bits);
+        std::int64_t player_x = unzigzag(x);
+        std::int64_t restored_score = unzigzag(score);
+        if (!(carry >= 0.0 && carry < 1.0) || restored_tick > static_cast<std::uint64_t>(std::numeric_limits<long>::max()) ||
+            !within(restored_score, 0, std::numeric_limits<int>::max()) || !within(player_x, 1, width - 2) ||
+            cooldown > static_cast<std::uint64_t>(Player::kFireCooldown)) {
+            return false;
+        }
+        tick = static_cast<long>(restored_tick);
+        factory.setRngState(factory_state);
+        bullet_rng = Rng(bullet_state);
+        spawner.setCarry(carry);
+        game.restore(static_cast<int>(restored_score), restored_game_over);
+        player.restore(static_cast<int>(player_x), static_cast<int>(cooldown));
+
+        if (!takeVarint(data, end, count)) return false;
+        enemies.clear();
+        for (std::uint64_t i = 0; i < count; ++i) {
+            std::uint64_t enemy_x, enemy_y, delta, health;
+            if (data == end) return false;
+            int type = static_cast<std::uint8_t>(*data++);
+            if (type >= kEnemyArchetypeCount || !takeVarint(data, end, enemy_x) || !takeVarint(data, end, enemy_y) ||
+                !takeVarint(data, end, delta) || !takeVarint(data, end, health)) {
+                return false;
+            }
+            const EnemyArchetype& archetype = archetypeOf(static_cast<EnemyType>(type));
+            std::int64_t ex = unzigzag(enemy_x), ey = unzigzag(enemy_y), moved = unzigzag(delta), hp = unzigzag(health);
+            if (!within(ex, 1, width) || !within(ey, 1, height) || !within(moved, -archetype.speed, 0) ||
+                !within(hp, 1, archetype.hit_points)) {
+                return false;
+            }
+            enemies.restore(archetype.type, static_cast<int>(ex), static_cast<int>(ey), static_cast<int>(ey + moved),
+                            static_cast<int>(hp));
+        }
+
+        BulletPool& bullets = player.getBullets();
+        if (!takeVarint(data, end, count) || count > bullets.capacity()) return false;
+        bullets.clear();
+        for (std::uint64_t i = 0; i < count; ++i) {
+            std::uint64_t bullet_x, bullet_y, delta;
+            if (!takeVarint(data, end, bullet_x) || !takeVarint(data, end, bullet_y) ||
+                !takeVarint(data, end, delta) || data == end) {
+                return false;
+            }
+            std::int64_t bx = unzigzag(bullet_x), by = unzigzag(bullet_y), moved = unzigzag(delta);
+            if (!within(bx, 1, width) || !within(by, 1, height) || !within(moved, 0, 1)) return false;
+            bullets.restore(static_cast<int>(bx), static_cast<int>(by), static_cast<int>(by + moved), *data++ != 0);
+        }
+        return true;
+    }
+
+    void restore(const GameSnapshot& snapshot) {
+        tick = snapshot.tick;
+        factory.setRngState(snapshot.factory_rng);
+        bullet_rng = Rng(snapshot.bullet_rng);
+        spawner.setCarry(snapshot.spawn_carry);
+        game.restore(snapshot.score, snapshot.game_over != 0);
+        player.restore(snapshot.player_x, snapshot.fire_cooldown);
+        enemies.clear();
+        for (int i = 0; i < snapshot.enemy_count; ++i) {
+            const GameSnapshot::Enemy& enemy = snapshot.enemies[i];
+            enemies.restore(static_cast<EnemyType>(enemy.type), enemy.x, enemy.y, enemy.prev_y, enemy.health);
+        }
+        BulletPool& bullets = player.getBullets();
+        bullets.clear();
+        for (int i = 0; i < snapshot.bullet_count; ++i) {
+            const GameSnapshot::Bullet& bullet = snapshot.bullets[i];
+            bullets.restore(bullet.x, bullet.y, bullet.prev_y, bullet.active != 0);
+        }
+    }
+
+    const BulletPool& getBullets() const { return player.getBullets(); }
+    BulletPool& getBullets() { return player.getBullets(); }
+    EnemyStore& getEnemies() { return enemies; }
+    const EnemyStore& getEnemies() const { return enemies; }
+
+    std::size_t memoryBytes() const {
+        return enemies.memoryBytes() + player.getBullets().memoryBytes() + bullet_grid.memoryBytes();
+    }
+
+    long getTick() const { return tick; }
+
+    std::uint64_t stateHash() const {
+        std::uint64_t hash = 0xCBF29CE484222325ULL;
+        auto mix = [&hash](std::int64_t value) {
+            hash ^= static_cast<std::uint64_t>(value);
+            hash *= 0x100000001B3ULL;
+        };
+        mix(tick);
+        mix(game.getScore());
+        mix(game.isGameOver());
+        mix(player.getX());
+        for (std::size_t i = 0; i < enemies.size(); ++i) {
+            mix(enemies.getX(i));
+            mix(enemies.getY(i));
+            mix(enemies.getPrevY(i));
+            mix(enemies.getHealth(i));
+            mix(static_cast<int>(enemies.getType(i)));
+            mix(enemies.active(i));
+        }
+        const BulletPool& bullets = player.getBullets();
+        for (std::size_t i = 0; i < bullets.size(); ++i) {
+            mix(bullets.getX(i));
+            mix(bullets.getY(i));
+            mix(bullets.active(i));
+        }
+        return hash;
+    }
+
+    void collide() {
+        if (collision_mode == CollisionMode::Naive) {
+            collideNaive();
+        } else {
+            collideGrid();
+        }
+    }
+
+    void step(const TickInput& input) {
+        if (profiled) PROFILE_BEGIN();
+        bool scatter = spawner.getSchedule().scatter;
+        for (long due = spawner.enemiesDue(tick, enemies.size()); due > 0; --due) {
+            factory.createRandomEnemy(enemies, scatter);
+        }
+        BulletPool& bullets = player.getBullets();
+        for (long due = spawner.bulletsDue(bullets.size()); due > 0; --due) {
+            if (!bullets.acquire(bullet_rng.uniform(1, game.getScreenWidth()),
+                                 bullet_rng.uniform(2, game.getScreenHeight()))) break;
+        }
+        if (profiled) PROFILE_LAP(Phase::Spawn);
+
+        for (int i = 0; i > input.move; --i) player.moveLeft();
+        for (int i = 0; i < input.move; ++i) player.moveRight();
+        if (input.fire) player.fire();
+        if (input.quit) game.endGame();
+        if (profiled) PROFILE_LAP(Phase::Input);
+
+        player.update(parallel(player.getBullets().size()) ? jobs : nullptr, kParallelGrain);
+        if (profiled) PROFILE_LAP(Phase::Player);
+        if (parallel(enemies.size())) {
+            int screen_height = game.getScreenHeight();
+            jobs->parallelFor(enemies.size(), kParallelGrain, [&](std::size_t begin, std::size_t end) {
+                enemies.update(screen_height, begin, end);
+            });
+        } else {
+            enemies.update(game.getScreenHeight());
+        }
+        if (profiled) PROFILE_LAP(Phase::Enemies);
+
+        collide();
+        if (profiled) PROFILE_LAP(Phase::Collision);
+
+        enemies.removeInactive();
+        if (profiled) PROFILE_LAP(Phase::Compaction);
+        events.dispatch();
+        if (profiled) PROFILE_LAP(Phase::Events);
+        tick++;
+    }
+
+    Viewport viewportFor(int columns, int rows) const {
+        return Viewport::following(player.getX(), player.getY(), columns, rows,
+                                   game.getScreenWidth(), game.getScreenHeight());
+    }
+
+    void draw(FrameBuffer& frame, const Viewport& view) const {
+        player.draw(frame, view);
+        enemies.draw(frame, view);
+    }
+};
+
+namespace snapshot_format {
+    constexpr char kMagic[4] = {'S', 'D', 'S', 'N'};
+    constexpr int kVersion = 1;
+}
+
+bool saveSnapshot(const std::string& path, const World& world) {
+    std::string out(snapshot_format::kMagic, sizeof(snapshot_format::kMagic));
+    out += static_cast<char>(snapshot_format::kVersion);
+    appendWorldConfig(out, world.getConfig());
+    world.serialize(out);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(out.data(), out.size());
+    return static_cast<bool>(file);
+}
+
+// The file's seed, geometry and spawn schedule replace those in config; the
+// collision mode and job system are kept.
+std::unique_ptr<World> loadSnapshot(const std::string& path, WorldConfig& config) {
+    std::ifstream file(path, std::ios::binary);
+    std::string in((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const char* data = in.data();
+    const char* end = data + in.size();
+    if (in.size() <= sizeof(snapshot_format::kMagic) ||
+        !std::equal(data, data + sizeof(snapshot_format::kMagic), snapshot_format::kMagic) ||
+        data[sizeof(snapshot_format::kMagic)] != snapshot_format::kVersion) {
+        return nullptr;
+    }
+    data += sizeof(snapshot_format::kMagic) + 1;
+    if (!takeWorldConfig(data, end, config)) return nullptr;
+
+    auto world = std::make_unique<World>(config);
+    if (!world->deserialize(data, end) || data != end) {
+        return nullptr;
+    }
+    return world;
+}
+
+class SnapshotRing {
+private:
+    std::vector<std::string> slots;
+    std::size_t head;
+    std::size_t count;
+
+public:
+    explicit SnapshotRing(std::size_t capacity) : slots(std::max<std::size_t>(1, capacity)), head(0), count(0) {}
+
+    std::size_t size() const { return count; }
+    std::size_t capacity() const { return slots.size(); }
+
+    void push(const World& world) {
+        std::string& slot = slots[head];
+        slot.clear();
+        world.serialize(slot);
+        head = (head + 1) % slots.size();
+        count = std::min(count + 1, slots.size());
+    }
+
+    // Restores the snapshot pushed `steps` pushes ago, or the oldest one, and
+    // drops it and everything newer so the next push continues from there.
+    bool rewind(std::size_t steps, World& world) {
+        if (count == 0) return false;
+        steps = std::min(std::max<std::size_t>(1, steps), count);
+        head = (head + slots.size() - steps) % slots.size();
+        count -= steps;
+        const char* data = slots[head].data();
+        return world.deserialize(data, data + slots[head].size());
+    }
+
+    std::size_t storedBytes() const {
+        std::size_t bytes = 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            bytes += slots[(head + slots.size() - 1 - i) % slots.size()].size();
+        }
+        return bytes;
+    }
+};
+
+class Autopilot {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    enum Action { Fire, Idle, Left, Right, ActionCount };
+
+    World scratch;
+    int depth;
+    std::vector<GameSnapshot> nodes;
+    long long searched;
+    long idle_fallbacks;
+    Clock::duration search_time;
+
+    static WorldConfig scratchConfig(WorldConfig config) {
+        config.jobs = nullptr;
+        config.profiled = false;
+        return config;
+    }
+
+    static TickInput inputFor(int action) {
+        TickInput input;
+        if (action == Fire) input.fire = true;
+        if (action == Left) input.move = -1;
+        if (action == Right) input.move = 1;
+        return input;
+    }
+
+    // Score dominates; ties go to bullets already lined up under scoring
+    // enemies, then to standing close to the nearest one. Values are summed
+    // along each path so the bot acts now rather than at the horizon.
+    double evaluate(const World& world) const {
+        if (world.isGameOver()) return -1e9 + world.getTick();
+        const EnemyStore& enemies = world.getEnemies();
+        const BulletPool& bullets = world.getBullets();
+        int player_x = world.getPlayer().getX();
+        int nearest = std::numeric_limits<int>::max();
+        double value = world.getGame().getScore() * 100.0;
+        for (std::size_t i = 0; i < enemies.size(); ++i) {
+            if (!enemies.active(i) || archetypeOf(enemies.getType(i)).score == 0) continue;
+            nearest = std::min(nearest, std::abs(enemies.getX(i) - player_x));
+            for (std::size_t j = 0; j < bullets.size(); ++j) {
+                if (bullets.active(j) && bullets.getX(j) == enemies.getX(i) && bullets.getY(j) > enemies.getY(i)) {
+                    value += 10.0;
+                }
+            }
+        }
+        if (nearest != std::numeric_limits<int>::max()) value -= nearest;
+        return value;
+    }
+
+    double expand(int level, int* best_action) {
+        double best = -std::numeric_limits<double>::infinity();
+        for (int action = 0; action < ActionCount; ++action) {
+            scratch.restore(nodes[level]);
+            scratch.step(inputFor(action));
+            searched++;
+            double value = evaluate(scratch);
+            if (level + 1 < depth && !scratch.isGameOver() && scratch.capture(nodes[level + 1])) {
+                value += expand(level + 1, nullptr);
+            }
+            if (value > best) {
+                best = value;
+                if (best_action != nullptr) *best_action = action;
+            }
+        }
+        return best;
+    }
+
+public:
+    Autopilot(const WorldConfig& config, int search_depth)
+        : scratch(scratchConfig(config)), depth(std::max(1, search_depth)), nodes(depth),
+          searched(0), idle_fallbacks(0), search_time(Clock::duration::zero()) {}
+
+    // Idles when the world has outgrown GameSnapshot; idleFallbacks() counts those ticks.
+    TickInput choose(const World& world) {
+        Clock::time_point start = Clock::now();
+        int action = Idle;
+        if (world.capture(nodes[0])) {
+            expand(0, &action);
+        } else {
+            idle_fallbacks++;
+        }
+        search_time += Clock::now() - start;
+        return inputFor(action);
+    }
+
+    int getDepth() const { return depth; }
+    long long searchedStates() const { return searched; }
+    long idleFallbacks() const { return idle_fallbacks; }
+    double searchSeconds() const { return std::chrono::duration<double>(search_time).count(); }
+};
+
+class FixedTimestep {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Clock::duration step_length;
+    Clock::duration frame_length;
+    int max_steps;
+    Clock::time_point last_time;
+    Clock::time_point next_frame;
+    Clock::duration accumulator;
+    long dropped_steps;
+
+public:
+    FixedTimestep(int steps_per_second, int frames_per_second, int max_catch_up_steps)
+        : step_length(std::chrono::duration_cast<Clock::duration>(std::chrono::seconds(1)) / steps_per_second),
+          frame_length(std::chrono::duration_cast<Clock::duration>(std::chrono::seconds(1)) / frames_per_second),
+          max_steps(max_catch_up_steps),
+          last_time(Clock::now()),
+          next_frame(last_time),
+          accumulator(Clock::duration::zero()),
+          dropped_steps(0) {}
+
+    long droppedSteps() const { return dropped_steps; }
+
+    int stepsDue() {
+        Clock::time_point now = Clock::now();
+        accumulator += now - last_time;
+        last_time = now;
+
+        int steps = static_cast<int>(accumulator / step_length);
+        if (steps > max_steps) {
+            dropped_steps += steps - max_steps;
+            steps = max_steps;
+            accumulator = Clock::duration::zero();
+        } else {
+            accumulator -= steps * step_length;
+        }
+        return steps;
+    }
+
+    bool frameDue() {
+        Clock::time_point now = Clock::now();
+        if (now < next_frame) return false;
+        next_frame += frame_length;
+        if (next_frame < now) {
+            next_frame = now + frame_length;
+        }
+        return true;
+    }
+
+    void waitForNext() const {
+        Clock::time_point next_step = last_time + (step_length - accumulator);
+        std::this_thread::sleep_until(std::min(next_step, next_frame));
+    }
+};
+
+// Smallest power-of-two square, at least 64 wide, with cells_per_entity
+// cells for every entity.
+int worldSideFor(long entities, long cells_per_entity) {
+    int side = 64;
+    while (static_cast<long>(side) * side < entities * cells_per_entity) {
+        side *= 2;
+    }
+    return side;
+}
+
+struct Options {
+    int frames_per_second = 20;
+    bool headless = false;
+    bool bench = false;
+    long bench_max_entities = 1000000;
+    bool profile = false;
+    long ticks = 10000;
+    bool has_ticks = false;
+    bool has_seed = false;
+    std::string script = ".";
+    std::string record_path;
+    std::string replay_path;
+    std::string save_path;
+    std::string load_path;
+    long stress_entities = 0;
+    long batch_games = 0;
+    bool autopilot = false;
+    int autopilot_depth = 4;
+    int threads = 1;
+    SimdLevel simd = MotionKernels::detect();
+    WorldConfig world;
+};
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--fps N] [--seed S] [--record FILE | --replay FILE]\n"
+              << "       " << program << " --headless [--ticks N] [--seed S] [--script KEYS]\n"
+              << "                  [--record FILE | --replay FILE]\n"
+              << "       " << program << " --stress N [--ticks N] [--seed S]\n"
+              << "       " << program << " --batch N [--ticks N] [--seed S] [--script KEYS] [--threads N]\n"
+              << "       " << program << " --bench [--bench-max N]\n"
+              << "\n"
+              << "  --script KEYS  one key per tick (a, d, f, q or '.' for idle), repeated\n"
+              << "  --record FILE  save the seed, world settings and every tick's input to FILE\n"
+              << "  --replay FILE  re-run a recorded game; its seed, world size, bullet pool,\n"
+              << "                 spawn schedule and input override the command line's\n"
+              << "                 --seed, --bullet-pool, --spawn-*, --stress sizing, --script\n"
+              << "                 and the keyboard; headless replays run to the end of the\n"
+              << "                 recording unless --ticks is given\n"
+              << "  --save FILE    write a binary snapshot of the final game state to FILE\n"
+              << "  --load FILE    continue from a snapshot written by --save; its world size\n"
+              << "                 and spawn schedule replace the command line's\n"
+              << "  --collision grid|naive\n"
+              << "                 broadphase used for bullet/enemy hits (default grid);\n"
+              << "                 naive is the all-pairs reference\n"
+              << "  --bullet-pool N\n"
+              << "                 preallocated player bullet slots (default 64)\n"
+              << "  --spawn-wave N:M\n"
+              << "                 spawn a burst of N enemies every M ticks (default 1:30;\n"
+              << "                 M = 0 disables waves)\n"
+              << "  --spawn-rate R steady enemies per tick on top of waves, may be fractional\n"
+              << "  --spawn-ramp R:T\n"
+              << "                 ramp the spawn rate linearly to R over the first T ticks\n"
+              << "  --stress N     headless run in a world sized for N entities that tops up\n"
+              << "                 to N live enemies and N live bullets every tick\n"
+              << "  --batch N      play N independent headless games with seeds S..S+N-1 on\n"
+              << "                 --threads workers and print the score distribution;\n"
+              << "                 --profile is ignored since the profiler is per process;\n"
+              << "                 --record, --replay, --save and --load are not accepted\n"
+              << "  --autopilot    let a lookahead bot play instead of the keyboard or --script\n"
+              << "                 ('q' still quits); reports searched states per second\n"
+              << "  --autopilot-depth N\n"
+              << "                 ticks the bot searches ahead, 4 actions per tick (default 4)\n"
+              << "  --threads N    split large entity updates and collision across N threads\n"
+              << "                 (0 = all cores); results match the single-threaded run\n"
+              << "  --simd auto|avx2|sse4.1|scalar\n"
+              << "                 instruction set for the enemy and bullet motion kernels\n"
+              << "                 (default auto: the best one this CPU supports)\n"
+              << "  --profile      time each game loop phase and print p50/p99/max on exit;\n"
+              << "                 SIGUSR1 prints the histograms so far to stderr\n"
+              << "  --bench        time the update, collision, spawn and render kernels at\n"
+              << "                 10 to --bench-max entities (default 1000000) and print JSON;\n"
+              << "                 --record, --replay, --save and --load are not accepted\n";
+}
+
+Options parseOptions(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--fps" && has_value) {
+            options.frames_per_second = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--headless") {
+            options.headless = true;
+        } else if (arg == "--bench") {
+            options.bench = true;
+        } else if (arg == "--bench-max" && has_value) {
+            options.bench_max_entities = std::max(10L, std::atol(argv[++i]));
+        } else if (arg == "--spawn-wave" && has_value) {
+            double size, interval;
+            constexpr double kMaxInt = std::numeric_limits<int>::max();
+            if (std::sscanf(argv[++i], "%lf:%lf", &size, &interval) != 2 ||
+                !(size >= 0 && size <= kMaxInt) || !(interval >= 0 && interval <= kMaxInt)) {
+                printUsage(argv[0]);
+                std::exit(1);
+            }
+            options.world.spawn.wave_size = static_cast<int>(size);
+            options.world.spawn.wave_interval = static_cast<int>(interval);
+        } else if (arg == "--spawn-rate" && has_value) {
+            options.world.spawn.rate = std::max(0.0, std::atof(argv[++i]));
+        } else if (arg == "--spawn-ramp" && has_value) {
+            double rate, ticks;
+            if (std::sscanf(argv[++i], "%lf:%lf", &rate, &ticks) != 2 || !(rate >= 0) ||
+                !(ticks >= 0 && ticks < static_cast<double>(std::numeric_limits<long>::max()))) {
+                printUsage(argv[0]);
+                std::exit(1);
+            }
+            options.world.spawn.ramp_to_rate = rate;
+            options.world.spawn.ramp_ticks = static_cast<long>(ticks);
+        } else if (arg == "--stress" && has_value) {
+            options.stress_entities = std::min<long>(std::max(1L, std::atol(argv[++i])), kMaxBulletCapacity);
+            options.headless = true;
+        } else if (arg == "--batch" && has_value) {
+            options.batch_games = std::max(1L, std::atol(argv[++i]));
+        } else if (arg == "--autopilot") {
+            options.autopilot = true;
+        } else if (arg == "--autopilot-depth" && has_value) {
+            options.autopilot_depth = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--threads" && has_value) {
+            options.threads = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--simd" && has_value) {
+            std::string level = argv[++i];
+            if (level == "auto") {
+                options.simd = MotionKernels::detect();
+            } else if (level == "avx2") {
+                options.simd = SimdLevel::Avx2;
+            } else if (level == "sse4.1") {
+                options.simd = SimdLevel::Sse41;
+            } else if (level == "scalar") {
+                options.simd = SimdLevel::Scalar;
+            } else {
+                printUsage(argv[0]);
+                std::exit(1);
+            }
+        } else if (arg == "--profile") {
+#ifdef SPACE_DEFENDER_NO_PROFILER
+            std::cerr << "--profile is not available: built with SPACE_DEFENDER_NO_PROFILER" << std::endl;
+            std::exit(1);
+#endif
+            options.profile = true;
+        } else if (arg == "--ticks" && has_value) {
+            options.has_ticks = true;
+            options.ticks = std::max(0L, std::atol(argv[++i]));
+        } else if (arg == "--seed" && has_value) {
+            options.has_seed = true;
+            options.world.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--script" && has_value) {
+            options.script = argv[++i];
+        } else if (arg == "--record" && has_value) {
+            options.record_path = argv[++i];
+        } else if (arg == "--replay" && has_value) {
+            options.replay_path = argv[++i];
+        } else if (arg == "--save" && has_value) {
+            options.save_path = argv[++i];
+        } else if (arg == "--load" && has_value) {
+            options.load_path = argv[++i];
+        } else if (arg == "--collision" && has_value) {
+            std::string mode = argv[++i];
+            if (mode == "grid") {
+                options.world.collision_mode = CollisionMode::Grid;
+            } else if (mode == "naive") {
+                options.world.collision_mode = CollisionMode::Naive;
+            } else {
+                printUsage(argv[0]);
+                std::exit(1);
+            }
+        } else if (arg == "--bullet-pool" && has_value) {
+            options.world.bullet_capacity = std::min<std::size_t>(std::max(1L, std::atol(argv[++i])), kMaxBulletCapacity);
+        } else {
+            printUsage(argv[0]);
+            std::exit(1);
+        }
+    }
+    bool uses_files = !options.record_path.empty() || !options.replay_path.empty() ||
+                      !options.save_path.empty() || !options.load_path.empty();
+    if ((!options.record_path.empty() && !options.replay_path.empty()) ||
+        (!options.load_path.empty() && (!options.record_path.empty() || !options.replay_path.empty())) ||
+        ((options.batch_games > 0 || options.bench) && uses_files)) {
+        printUsage(argv[0]);
+        std::exit(1);
+    }
+    if (options.script.empty()) {
+        options.script = ".";
+    }
+    if (!options.has_seed) {
+        std::random_device rd;
+        options.world.seed = rd();
+    }
+    if (options.threads == 0) {
+        options.threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    if (options.stress_entities > 0) {
+        SpawnSchedule& spawn = options.world.spawn;
+        spawn.target_enemies = options.stress_entities;
+        spawn.target_bullets = options.stress_entities;
+        spawn.scatter = true;
+        options.world.bullet_capacity = options.stress_entities;
+        options.world.width = options.world.height = worldSideFor(options.stress_entities, 16);
+    }
+    std::uint64_t cells = static_cast<std::uint64_t>(options.world.width) * options.world.height;
+    if (!validSpawnRate(options.world.spawn.rate, cells) || !validSpawnRate(options.world.spawn.ramp_to_rate, cells) ||
+        static_cast<std::uint64_t>(options.world.spawn.wave_size) > cells) {
+        std::cerr << "Spawn rates and wave sizes must be finite and at most one per world cell" << std::endl;
+        std::exit(1);
+    }
+    return options;
+}
+
+void printBulletPoolStats(const BulletPool& bullets) {
+    std::cout << "Bullet pool: capacity " << bullets.capacity()
+              << " | high water " << bullets.highWater()
+              << " | exhausted " << bullets.exhaustedCount() << std::endl;
+}
+
+void printAutopilotStats(long long searched, double seconds, int depth, long idle_fallbacks) {
+    std::cout << "Autopilot: depth " << depth
+              << " | searched states: " << searched
+              << " | states/s: " << static_cast<long long>(searched / std::max(seconds, 1e-9))
+              << " | unsearched ticks: " << idle_fallbacks << std::endl;
+    if (idle_fallbacks > 0) {
+        std::cerr << "Warning: the autopilot idled for " << idle_fallbacks << " ticks because the world had more than "
+                  << GameSnapshot::kMaxEnemies << " enemies or " << GameSnapshot::kMaxBullets << " bullets" << std::endl;
+    }
+}
+
+std::unique_ptr<World> createWorld(const Options& options, WorldConfig& config) {
+    if (options.load_path.empty()) {
+        return std::make_unique<World>(config);
+    }
+    std::unique_ptr<World> world = loadSnapshot(options.load_path, config);
+    if (!world) {
+        std::cerr << "Cannot read snapshot file " << options.load_path << std::endl;
+    }
+    return world;
+}
+
+bool saveFinalSnapshot(const Options& options, const World& world) {
+    if (options.save_path.empty()) return true;
+    if (!saveSnapshot(options.save_path, world)) {
+        std::cerr << "Cannot write snapshot file " << options.save_path << std::endl;
+        return false;
+    }
+    std::cout << "Snapshot: tick " << world.getTick() << " saved to " << options.save_path << std::endl;
+    return true;
+}
+
+void printProfile() {
+#ifndef SPACE_DEFENDER_NO_PROFILER
+    if (FrameProfiler::getInstance().isEnabled()) {
+        FrameProfiler::getInstance().print(stdout);
+    }
+#endif
+}
+
+int runHeadless(const Options& options, InputRecorder& recorder, InputReplay* replay) {
+    bool stress = options.stress_entities > 0;
+    JobSystem jobs(options.threads);
+    WorldConfig config = options.world;
+    config.jobs = options.threads > 1 ? &jobs : nullptr;
+    std::unique_ptr<World> loaded = createWorld(options, config);
+    if (!loaded) return 1;
+    World& world = *loaded;
+    const GameManager& game = world.getGame();
+    std::unique_ptr<Autopilot> bot;
+    if (options.autopilot && replay == nullptr) {
+        bot = std::make_unique<Autopilot>(config, options.autopilot_depth);
+    }
+
+    long tick_limit = replay != nullptr && !options.has_ticks ? std::numeric_limits<long>::max() : options.ticks;
+    auto start = std::chrono::steady_clock::now();
+    for (long tick = 0; tick < tick_limit && (stress || replay != nullptr || !game.isGameOver()); ++tick) {
+        TickInput input;
+        if (replay != nullptr) {
+            if (replay->finished(tick)) break;
+            input = replay->inputFor(tick);
+        } else if (bot) {
+            input = bot->choose(world);
+        } else {
+            input.addKey(options.script[world.getTick() % options.script.size()]);
+        }
+        recorder.record(tick, input);
+        world.step(input);
+        PROFILE_DUMP_IF_REQUESTED();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    recorder.finish(world.getTick());
+    if (replay != nullptr && !replay->finished(world.getTick())) {
+        std::cerr << "Warning: replay stopped at tick " << world.getTick()
+                  << " by --ticks before the recording ended" << std::endl;
+    }
+
+    std::cout << "Seed: " << config.seed
+              << " | ticks: " << world.getTick()
+              << " | ticks/s: " << static_cast<long>(world.getTick() / std::max(elapsed.count(), 1e-9))
+              << " | score: " << game.getScore()
+              << " | game over: " << (game.isGameOver() ? "yes" : "no") << std::endl;
+    std::cout << "Threads: " << options.threads
+              << " | simd: " << simdLevelName(MotionKernels::current().level)
+              << " | state hash: " << std::hex << world.stateHash() << std::dec << std::endl;
+    printBulletPoolStats(world.getBullets());
+    if (bot) {
+        printAutopilotStats(bot->searchedStates(), bot->searchSeconds(), bot->getDepth(), bot->idleFallbacks());
+    }
+    if (stress) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        std::cout << "World: " << game.getScreenWidth() << "x" << game.getScreenHeight()
+                  << " | live enemies: " << world.getEnemies().size()
+                  << " | live bullets: " << world.getBullets().size()
+                  << " | entity memory: " << world.memoryBytes() / (1024 * 1024) << " MiB"
+                  << " | peak RSS: " << usage.ru_maxrss / 1024 << " MiB" << std::endl;
+    }
+    bool saved = saveFinalSnapshot(options, world);
+    printProfile();
+    return saved ? 0 : 1;
+}
+
+struct GameResult {
+    long ticks;
+    int score;
+    bool game_over;
+    std::uint64_t hash;
+    long long searched_states;
+    double search_seconds;
+    long idle_fallbacks;
+};
+
+GameResult playHeadless(const WorldConfig& config, const Options& options) {
+    World world(config);
+    std::unique_ptr<Autopilot> bot;
+    if (options.autopilot) {
+        bot = std::make_unique<Autopilot>(config, options.autopilot_depth);
+    }
+    for (long tick = 0; tick < options.ticks && !world.isGameOver(); ++tick) {
+        TickInput input;
+        if (bot) {
+            input = bot->choose(world);
+        } else {
+            input.addKey(options.script[tick % options.script.size()]);
+        }
+        world.step(input);
+    }
+    return GameResult{world.getTick(), world.getGame().getScore(), world.isGameOver(), world.stateHash(),
+                      bot ? bot->searchedStates() : 0, bot ? bot->searchSeconds() : 0.0,
+                      bot ? bot->idleFallbacks() : 0};
+}
+
+int runBatch(const Options& options) {
+    JobSystem jobs(options.threads);
+    std::vector<GameResult> results(options.batch_games);
+
+    auto start = std::chrono::steady_clock::now();
+    jobs.parallelFor(results.size(), 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            WorldConfig config = options.world;
+            config.seed = options.world.seed + i;
+            config.jobs = nullptr;
+            results[i] = playHeadless(config, options);
+        }
+    });
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    long total_ticks = 0;
+    long games_over = 0;
+    long long searched = 0;
+    double search_seconds = 0.0;
+    long idle_fallbacks = 0;
+    std::uint64_t hash = 0xCBF29CE484222325ULL;
+    std::vector<int> scores;
+    scores.reserve(results.size());
+    for (const GameResult& result : results) {
+        total_ticks += result.ticks;
+        games_over += result.game_over;
+        scores.push_back(result.score);
+        searched += result.searched_states;
+        search_seconds += result.search_seconds;
+        idle_fallbacks += result.idle_fallbacks;
+        hash = (hash ^ result.hash) * 0x100000001B3ULL;
+    }
+    std::sort(scores.begin(), scores.end());
+    auto scoreAt = [&scores](double fraction) {
+        return scores[static_cast<std::size_t>(fraction * (scores.size() - 1))];
+    };
+    double seconds = std::max(elapsed.count(), 1e-9);
+
+    std::cout << "Batch: " << results.size() << " games | seeds " << options.world.seed
+              << ".." << options.world.seed + results.size() - 1
+              << " | threads: " << jobs.threadCount() << std::endl;
+    std::cout << "Games/s: " << static_cast<long>(results.size() / seconds)
+              << " | ticks: " << total_ticks
+              << " | ticks/s: " << static_cast<long>(total_ticks / seconds)
+              << " | game over: " << games_over << "/" << results.size()
+              << " | mean survival: " << total_ticks / static_cast<long>(results.size()) << " ticks" << std::endl;
+    std::cout << "Score: min " << scores.front()
+              << " | p50 " << scoreAt(0.50)
+              << " | p90 " << scoreAt(0.90)
+              << " | max " << scores.back()
+              << " | batch hash: " << std::hex << hash << std::dec << std::endl;
+    if (options.autopilot) {
+        printAutopilotStats(searched, search_seconds, options.autopilot_depth, idle_fallbacks);
+    }
+    return 0;
+}
+
+struct BenchResult {
+    std::string name;
+    long entities;
+    int reps;
+    double median_ns;
+    double min_ns;
+};
+
+template <typename Setup, typename Body>
+BenchResult measureKernel(const std::string& name, long entities, Setup&& setup, Body&& body) {
+    constexpr int kMinReps = 5;
+    constexpr double kBudgetNs = 1e9;
+    int max_reps = static_cast<int>(std::max<long>(kMinReps, std::min(2000L, 2000000L / entities)));
+    std::vector<double> samples;
+    double total_ns = 0;
+    while (static_cast<int>(samples.size()) < max_reps &&
+           (static_cast<int>(samples.size()) < kMinReps || total_ns < kBudgetNs)) {
+        setup();
+        auto start = std::chrono::steady_clock::now();
+        body();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        samples.push_back(elapsed.count());
+        total_ns += elapsed.count();
+    }
+    std::sort(samples.begin(), samples.end());
+    return BenchResult{name, entities, static_cast<int>(samples.size()), samples[samples.size() / 2], samples.front()};
+}
+
+void populate(World& world, long entities, int side, std::uint64_t seed) {
+    Rng rng(seed);
+    EnemyStore& enemies = world.getEnemies();
+    BulletPool& bullets = world.getBullets();
+    for (long i = 0; i < entities; ++i) {
+        enemies.spawn(static_cast<EnemyType>(rng.uniform(0, kEnemyArchetypeCount - 1)),
+                      rng.uniform(1, side), rng.uniform(1, side));
+        bullets.acquire(rng.uniform(1, side), rng.uniform(2, side));
+    }
+    enemies.update(side);
+    bullets.update(0, bullets.size());
+}
+
+int runBenchmarks(const Options& options) {
+    std::vector<BenchResult> results;
+    int null_fd = open("/dev/null", O_WRONLY);
+
+    for (long entities = 10; entities <= options.bench_max_entities; entities *= 10) {
+        int side = worldSideFor(entities, 8);
+        WorldConfig config = options.world;
+        config.width = config.height = side;
+        config.bullet_capacity = entities;
+
+        {
+            EnemyStore enemies;
+            Rng rng(1);
+            for (long i = 0; i < entities; ++i) {
+                enemies.spawn(static_cast<EnemyType>(rng.uniform(0, kEnemyArchetypeCount - 1)), rng.uniform(1, side));
+            }
+            BulletPool bullets(entities);
+            while (bullets.acquire(rng.uniform(1, side), std::numeric_limits<int>::max() / 2)) {}
+
+            const MotionKernels selected = MotionKernels::current();
+            for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Sse41, SimdLevel::Avx2}) {
+                if (level > MotionKernels::detect()) continue;
+                MotionKernels::current() = MotionKernels::forLevel(level);
+                std::string suffix = std::string("_") + simdLevelName(level);
+                results.push_back(measureKernel("enemy_update" + suffix, entities, [] {}, [&] {
+                    enemies.update(std::numeric_limits<int>::max() / 2);
+                }));
+                results.push_back(measureKernel("bullet_update" + suffix, entities, [] {}, [&] {
+                    bullets.update(0, bullets.size());
+                }));
+            }
+            MotionKernels::current() = selected;
+        }
+
+        {
+            Player player(entities, side, side);
+            Rng rng(2);
+            auto refill = [&] {
+                while (player.getBullets().acquire(rng.uniform(1, side), rng.uniform(2, side))) {}
+            };
+            results.push_back(measureKernel("player_update", entities, refill, [&] {
+                player.update();
+            }));
+        }
+
+        for (CollisionMode mode : {CollisionMode::Grid, CollisionMode::Naive}) {
+            if (mode == CollisionMode::Naive && entities > 10000) continue;
+            config.collision_mode = mode;
+            World pristine(config);
+            populate(pristine, entities, side, 3);
+            std::unique_ptr<World> working;
+            results.push_back(measureKernel(mode == CollisionMode::Grid ? "collision_grid" : "collision_naive", entities,
+                [&] { working = std::make_unique<World>(pristine); },
+                [&] { working->collide(); }));
+        }
+
+        {
+            EnemyStore enemies;
+            EnemyFactory factory(4, side, side);
+            results.push_back(measureKernel("create_random_enemy", entities,
+                [&] { enemies = EnemyStore(); },
+                [&] {
+                    for (long i = 0; i < entities; ++i) {
+                        factory.createRandomEnemy(enemies);
+                    }
+                }));
+        }
+
+        {
+            // Alternating between two layouts makes every rep redraw all entities
+            // instead of diffing an unchanged frame.
+            World layouts[2] = {World(config), World(config)};
+            populate(layouts[0], entities, side, 5);
+            populate(layouts[1], entities, side, 7);
+            std::size_t shown = 0;
+            FrameBuffer frame(side, side);
+            frame.setOutput(null_fd);
+            results.push_back(measureKernel("render_frame", entities, [&] { shown ^= 1; }, [&] {
+                frame.clear();
+                layouts[shown].draw(frame, Viewport(0, 0, side, side));
+                frame.present();
+            }));
+        }
+
+        {
+            World world(config);
+            populate(world, entities, side, 6);
+            world.getEnemies().removeInactive();
+            std::string blob;
+            results.push_back(measureKernel("snapshot_save", entities, [&] { blob.clear(); }, [&] {
+                world.serialize(blob);
+            }));
+            World target(config);
+            results.push_back(measureKernel("snapshot_load", entities, [] {}, [&] {
+                const char* data = blob.data();
+                target.deserialize(data, data + blob.size());
+            }));
+        }
+    }
+    if (null_fd >= 0) close(null_fd);
+
+    std::cout << "{\n  \"benchmarks\": [\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& result = results[i];
+        std::cout << "    {\"name\": \"" << result.name << "\""
+                  << ", \"entities\": " << result.entities
+                  << ", \"reps\": " << result.reps
+                  << ", \"median_ns\": " << static_cast<long long>(result.median_ns)
+                  << ", \"min_ns\": " << static_cast<long long>(result.min_ns)
+                  << ", \"median_ns_per_entity\": " << result.median_ns / result.entities
+                  << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    std::cout << "  ]\n}" << std::endl;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    constexpr int kStepsPerSecond = 20;
+    constexpr int kMaxCatchUpSteps = 5;
+    constexpr int kFinalDrainMs = 2000;
+    constexpr std::size_t kRewindCapacity = 2000;
+    constexpr std::size_t kRewindSteps = 60;
+
+    Options options = parseOptions(argc, argv);
+    MotionKernels::current() = MotionKernels::forLevel(options.simd);
+#ifndef SPACE_DEFENDER_NO_PROFILER
+    if (options.profile && options.batch_games == 0) {
+        FrameProfiler::getInstance().enable();
+    }
+#endif
+
+    InputReplay replay;
+    if (!options.replay_path.empty()) {
+        if (!replay.load(options.replay_path, options.world)) {
+            std::cerr << "Cannot read replay file " << options.replay_path << std::endl;
+            return 1;
+        }
+    }
+    InputReplay* replay_source = options.replay_path.empty() ? nullptr : &replay;
+
+    InputRecorder recorder;
+    if (!options.record_path.empty() && !recorder.open(options.record_path, options.world)) {
+        std::cerr << "Cannot write replay file " << options.record_path << std::endl;
+        return 1;
+    }
+
+    if (options.bench) {
+        return runBenchmarks(options);
+    }
+    if (options.batch_games > 0) {
+        return runBatch(options);
+    }
+    if (options.headless) {
+        return runHeadless(options, recorder, replay_source);
+    }
+
+    WorldConfig config = options.world;
+    std::unique_ptr<World> loaded = createWorld(options, config);
+    if (!loaded) return 1;
+    World& world = *loaded;
+
+    TerminalSession terminal;
+    InputReader input_reader(terminal);
+    GameManager& game = world.getGame();
+    std::unique_ptr<Autopilot> bot;
+    if (options.autopilot && replay_source == nullptr) {
+        bot = std::make_unique<Autopilot>(config, options.autopilot_depth);
+    }
+    bool can_rewind = replay_source == nullptr && !recorder.isOpen();
+    SnapshotRing history(can_rewind ? kRewindCapacity : 1);
+    int columns = game.getScreenWidth();
+    int rows = game.getScreenHeight();
+    terminal.querySize(columns, rows);
+    FrameBuffer frame(columns, rows);
+    frame.setOutput(terminal.outputFd());
+    FixedTimestep timestep(kStepsPerSecond, options.frames_per_second, kMaxCatchUpSteps);
+
+    while (!game.isGameOver()) {
+        int steps = timestep.stepsDue();
+        for (int i = 0; i < steps && !game.isGameOver(); ++i) {
+            long tick = world.getTick();
+            TickInput input = input_reader.drain();
+            if (input.rewind && can_rewind) {
+                history.rewind(kRewindSteps, world);
+                if (input.quit) game.endGame();
+                continue;
+            }
+            if (replay_source != nullptr) {
+                if (replay_source->finished(tick)) {
+                    game.endGame();
+                    break;
+                }
+                bool quit = input.quit;
+                input = replay_source->inputFor(tick);
+                input.quit = input.quit || quit;
+            } else if (bot) {
+                bool quit = input.quit;
+                input = bot->choose(world);
+                input.quit = quit;
+            }
+            if (can_rewind) {
+                history.push(world);
+            }
+            recorder.record(tick, input);
+            world.step(input);
+        }
+
+        if (timestep.frameDue()) {
+            PROFILE_BEGIN();
+            if (terminal.takeResize() && terminal.querySize(columns, rows)) {
+                frame.resize(columns, rows);
+            }
+            frame.clear();
+            world.draw(frame, world.viewportFor(columns, rows));
+            PROFILE_LAP(Phase::Draw);
+            game.drawUI(frame, can_rewind);
+            PROFILE_LAP(Phase::Ui);
+            if (frame.present()) {
+                PROFILE_FRAME_BYTES(frame.lastStats().bytes);
+            }
+            PROFILE_LAP(Phase::Present);
+        }
+
+        PROFILE_DUMP_IF_REQUESTED();
+        timestep.waitForNext();
+    }
+    recorder.finish(world.getTick());
 
     std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-    std::cout << "\033[2J";
-    game.drawUI();
+    if (terminal.takeResize() && terminal.querySize(columns, rows)) {
+        frame.resize(columns, rows);
+    }
+    frame.clear();
+    game.drawUI(frame, can_rewind);
+    frame.drain(kFinalDrainMs);
+    frame.present(false);
+    frame.drain(kFinalDrainMs);
+    terminal.restore();
     std::cout << std::endl;
-    
-    return 0;
-}
\ No newline at end of file
+
+    if (frame.frameCount() > 0) {
+        const FrameStats& total = frame.totalStats();
+        std::cout << "Frames: " << frame.frameCount()
+                  << " | avg bytes/frame: " << total.bytes / frame.frameCount()
+                  << " (peak " << frame.peakStats().bytes << ")"
+                  << " | avg writes/frame: " << static_cast<double>(total.syscalls) / frame.frameCount()
+                  << " (peak " << frame.peakStats().syscalls << ")"
+                  << " | skipped for backpressure: " << frame.skippedFrames() << std::endl;
+    }
+    std::cout << "Max input latency: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(input_reader.maxLatency()).count() << " ms"
+              << " | dropped keys: " << input_reader.droppedKeys() << std::endl;
+    std::cout << "Simulation steps: " << world.getTick()
+              << " | dropped catch-up steps: " << timestep.droppedSteps() << std::endl;
+    printBulletPoolStats(world.getBullets());
+    if (bot) {
+        printAutopilotStats(bot->searchedStates(), bot->searchSeconds(), bot->getDepth(), bot->idleFallbacks());
+    }
+    if (history.size() > 0) {
+        std::cout << "Rewind buffer: " << history.size() << "/" << history.capacity() << " snapshots"
+                  << " | avg " << history.storedBytes() / history.size() << " bytes" << std::endl;
+    }
+    bool saved = saveFinalSnapshot(options, world);
+    printProfile();
+
+    return saved ? 0 : 1;
+}